@@ -0,0 +1,255 @@
+#include "alsa-capture.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+AlsaCapture *AlsaCapture::Open(const char *pcm_device, unsigned int rate,
+                               int channels, int period_frames,
+                               int buffer_frames, bool use_mmap) {
+  int err;
+  snd_pcm_t *capture_handle = NULL;
+  snd_pcm_hw_params_t *hw_params = NULL;
+
+  if ((err = snd_pcm_open (&capture_handle, pcm_device, SND_PCM_STREAM_CAPTURE, 0)) < 0) {
+    fprintf (stderr, "cannot open audio device %s (%s)\n", 
+             pcm_device,
+             snd_strerror (err));
+    return NULL;
+  }
+		   
+  if ((err = snd_pcm_hw_params_malloc (&hw_params)) < 0) {
+    fprintf (stderr, "cannot allocate hardware parameter structure (%s)\n",
+             snd_strerror (err));
+    snd_pcm_close(capture_handle);
+    return NULL;
+  }
+
+  // Bail out of the parameter negotiation with a message.
+#define HW_PARAM_CHECK(call, msg)                                 \
+  if ((err = (call)) < 0) {                                       \
+    fprintf (stderr, msg " (%s)\n", snd_strerror (err));          \
+    snd_pcm_hw_params_free (hw_params);                           \
+    snd_pcm_close(capture_handle);                                \
+    return NULL;                                                  \
+  }
+
+  HW_PARAM_CHECK(snd_pcm_hw_params_any (capture_handle, hw_params),
+                 "cannot initialize hardware parameter structure");
+  // Not all devices and plugins can be mapped; reading works with all.
+  const bool mmap = use_mmap
+    && snd_pcm_hw_params_set_access(capture_handle, hw_params,
+                                    SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0;
+  if (!mmap) {
+    HW_PARAM_CHECK(snd_pcm_hw_params_set_access (capture_handle, hw_params,
+                                                 SND_PCM_ACCESS_RW_INTERLEAVED),
+                   "cannot set access type");
+  }
+  HW_PARAM_CHECK(snd_pcm_hw_params_set_format (capture_handle, hw_params,
+                                               SND_PCM_FORMAT_S16_LE),
+                 "cannot set sample format");
+  HW_PARAM_CHECK(snd_pcm_hw_params_set_rate_near(capture_handle,
+                                                 hw_params, &rate, 0),
+                 "cannot set sample rate");
+  HW_PARAM_CHECK(snd_pcm_hw_params_set_channels (capture_handle, hw_params,
+                                                 channels),
+                 "cannot set channel count");
+  if (period_frames > 0) {
+    snd_pcm_uframes_t frames = period_frames;
+    HW_PARAM_CHECK(snd_pcm_hw_params_set_period_size_near(capture_handle,
+                                                          hw_params, &frames,
+                                                          0),
+                   "cannot set period size");
+  }
+  if (buffer_frames > 0) {
+    snd_pcm_uframes_t frames = buffer_frames;
+    HW_PARAM_CHECK(snd_pcm_hw_params_set_buffer_size_near(capture_handle,
+                                                          hw_params, &frames),
+                   "cannot set buffer size");
+  }
+  HW_PARAM_CHECK(snd_pcm_hw_params (capture_handle, hw_params),
+                 "cannot set parameters");
+  // What the device settled on.
+  snd_pcm_uframes_t period = 0, buffer = 0;
+  HW_PARAM_CHECK(snd_pcm_hw_params_get_period_size(hw_params, &period, 0),
+                 "cannot get period size");
+  HW_PARAM_CHECK(snd_pcm_hw_params_get_buffer_size(hw_params, &buffer),
+                 "cannot get buffer size");
+#undef HW_PARAM_CHECK
+
+  snd_pcm_hw_params_free (hw_params);
+	
+  if ((err = snd_pcm_prepare (capture_handle)) < 0) {
+    fprintf (stderr, "cannot prepare audio interface for use (%s)\n",
+             snd_strerror (err));
+    snd_pcm_close(capture_handle);
+    return NULL;
+  }
+  // For Interrupt() to wake up Wait().
+  const int interrupt_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (interrupt_fd < 0) {
+    fprintf (stderr, "cannot create wakeup eventfd (%s)\n", strerror(errno));
+    snd_pcm_close(capture_handle);
+    return NULL;
+  }
+  return new AlsaCapture(capture_handle, interrupt_fd, rate, channels,
+                         period, buffer, mmap);
+}
+
+AlsaCapture::AlsaCapture(snd_pcm_t *handle, int interrupt_fd,
+                         unsigned int rate, int channels,
+                         int period_frames, int buffer_frames, bool mmap)
+  : handle_(handle), sample_rate_(rate), channels_(channels),
+    period_frames_(period_frames), buffer_frames_(buffer_frames),
+    mmap_(mmap), interrupt_fd_(interrupt_fd),
+    xruns_(0), last_error_(0) {
+  // Reads go through this a period at a time, so that the capture thread
+  // doesn't allocate.
+  if (!mmap_) interleaved_.resize(std::max(period_frames_, 1) * channels_);
+  const int count = snd_pcm_poll_descriptors_count(handle_);
+  pollfds_.resize((count > 0 ? count : 0) + 1);
+}
+
+AlsaCapture::~AlsaCapture() {
+  close(interrupt_fd_);
+  snd_pcm_close(handle_);
+}
+
+void AlsaCapture::Interrupt() {
+  eventfd_write(interrupt_fd_, 1);
+}
+
+bool AlsaCapture::Recover(int err) {
+  // Overrun or suspend: count it and resume instead of giving up.
+  if (err == -EPIPE || err == -ESTRPIPE)
+    xruns_.fetch_add(1, std::memory_order_relaxed);
+  last_error_ = snd_pcm_recover(handle_, err, 1);
+  return last_error_ >= 0;
+}
+
+bool AlsaCapture::Wait(int frames) {
+  for (;;) {
+    // Reading starts the capture by itself, mmap access doesn't.
+    if (snd_pcm_state(handle_) == SND_PCM_STATE_PREPARED) {
+      const int err = snd_pcm_start(handle_);
+      if (err < 0 && !Recover(err))
+        return false;
+    }
+    const snd_pcm_sframes_t avail = snd_pcm_avail_update(handle_);
+    if (avail < 0) {
+      if (!Recover(avail))
+        return false;
+      continue;
+    }
+    if (avail >= frames)
+      return true;
+    const int count = snd_pcm_poll_descriptors(handle_, pollfds_.data(),
+                                               pollfds_.size() - 1);
+    if (count < 0) {
+      last_error_ = count;
+      return false;
+    }
+    struct pollfd &interrupt = pollfds_[count];
+    interrupt.fd = interrupt_fd_;
+    interrupt.events = POLLIN;
+    interrupt.revents = 0;
+    if (poll(pollfds_.data(), count + 1, 1000) < 0) {
+      if (errno == EINTR)
+        continue;
+      last_error_ = -errno;
+      return false;
+    }
+    if (interrupt.revents != 0) {
+      eventfd_t ignored;
+      eventfd_read(interrupt_fd_, &ignored);
+      return true;
+    }
+    // Needed for the device to make sense of what happened; an error shows
+    // up on the next avail_update(), and is recovered from then.
+    unsigned short revents = 0;
+    const int err = snd_pcm_poll_descriptors_revents(handle_, pollfds_.data(),
+                                                     count, &revents);
+    if (err < 0 && !Recover(err))
+      return false;
+  }
+}
+
+bool AlsaCapture::Read(short *const *buffers, int frames) {
+  int done = 0;
+  while (done < frames) {
+    const snd_pcm_sframes_t r = mmap_
+      ? ReadMmap(buffers, done, frames - done)
+      : ReadCopy(buffers, done, frames - done);
+    if (r == -EAGAIN)
+      continue;
+    if (r < 0) {
+      if (!Recover(r))
+        return false;
+      continue;
+    }
+    if (r == 0 && !Wait(frames - done))
+      return false;
+    done += r;
+  }
+  return true;
+}
+
+snd_pcm_sframes_t AlsaCapture::ReadMmap(short *const *buffers, int done,
+                                        int frames) {
+  const snd_pcm_channel_area_t *areas;
+  snd_pcm_uframes_t offset;
+  snd_pcm_uframes_t available = frames;
+  const snd_pcm_sframes_t avail = snd_pcm_avail_update(handle_);
+  if (avail < 0)
+    return avail;
+  const int err = snd_pcm_mmap_begin(handle_, &areas, &offset, &available);
+  if (err < 0)
+    return err;
+  // Copy each channel from the driver's buffer to where it is analyzed;
+  // for interleaved access, the areas are "step" bits apart.
+  for (int c = 0; c < channels_; ++c) {
+    if (buffers[c] == NULL)
+      continue;
+    const snd_pcm_channel_area_t &area = areas[c];
+    const int step = area.step / 16;
+    const short *in = (const short*) area.addr
+      + (area.first + offset * area.step) / 16;
+    short *out = buffers[c] + done;
+    for (snd_pcm_uframes_t i = 0; i < available; ++i, in += step) {
+      out[i] = *in;
+    }
+  }
+  const snd_pcm_sframes_t committed =
+    snd_pcm_mmap_commit(handle_, offset, available);
+  if (committed < 0)
+    return committed;
+  // The driver overwrote the part we copied in the meantime.
+  if ((snd_pcm_uframes_t) committed != available)
+    return -EPIPE;
+  return committed;
+}
+
+snd_pcm_sframes_t AlsaCapture::ReadCopy(short *const *buffers, int done,
+                                        int frames) {
+  // A single channel is read straight to where it goes.
+  if (channels_ == 1 && buffers[0] != NULL)
+    return snd_pcm_readi(handle_, buffers[0] + done, frames);
+  frames = std::min(frames, (int) interleaved_.size() / channels_);
+  const snd_pcm_sframes_t r = snd_pcm_readi(handle_, interleaved_.data(),
+                                            frames);
+  for (int c = 0; c < channels_ && r > 0; ++c) {
+    if (buffers[c] == NULL)
+      continue;
+    const short *in = interleaved_.data() + c;
+    short *out = buffers[c] + done;
+    for (snd_pcm_sframes_t i = 0; i < r; ++i, in += channels_) {
+      out[i] = *in;
+    }
+  }
+  return r;
+}
@@ -0,0 +1,79 @@
+#ifndef PITCH_HERO_ALSA_CAPTURE_H
+#define PITCH_HERO_ALSA_CAPTURE_H
+
+#include <alsa/asoundlib.h>
+#include <poll.h>
+
+#include <atomic>
+#include <vector>
+
+// Captures 16 bit audio from an ALSA device, with one or more interleaved
+// channels.
+//
+// If the device allows it, the samples are taken straight from the
+// driver's ring buffer (mmap access), each channel copied to where it is
+// analyzed; otherwise they are read into a buffer of ours first.
+class AlsaCapture {
+public:
+  // Open "device" for capture of "channels" channels with a sample rate
+  // close to "rate". "period_frames" and "buffer_frames" ask for the
+  // period and buffer size, and with that the capture latency; 0 leaves
+  // them to the device. With "use_mmap" false, always read instead of
+  // using mmap access. Returns NULL and prints a message on failure.
+  static AlsaCapture *Open(const char *device, unsigned int rate,
+                           int channels, int period_frames,
+                           int buffer_frames, bool use_mmap);
+  ~AlsaCapture();
+
+  unsigned int sample_rate() const { return sample_rate_; }
+  int channels() const { return channels_; }
+  int period_frames() const { return period_frames_; }
+  int buffer_frames() const { return buffer_frames_; }
+  bool mmap() const { return mmap_; }
+
+  // Block until "frames" frames are ready to be read, or Interrupt();
+  // starts the capture if needed. Waits in poll() on the device's
+  // descriptors. Returns false on an error we can't recover from.
+  bool Wait(int frames);
+
+  // Make a Wait() in another thread return right away, e.g. to shut down.
+  void Interrupt();
+
+  // Read exactly "frames" frames, waiting for them if needed. The samples
+  // of channel c go to "buffers[c]"; those of channels with a NULL buffer
+  // are dropped. Overruns are recovered from and counted.
+  // Returns false on an error we can't recover from; last_error() has the
+  // reason.
+  bool Read(short *const *buffers, int frames);
+
+  // Number of overruns so far; can be read from any thread.
+  int xruns() const { return xruns_.load(std::memory_order_relaxed); }
+  int last_error() const { return last_error_; }
+
+private:
+  AlsaCapture(snd_pcm_t *handle, int interrupt_fd,
+              unsigned int rate, int channels,
+              int period_frames, int buffer_frames, bool mmap);
+
+  // Recover from "err"; returns false if that is not possible.
+  bool Recover(int err);
+
+  // Read up to "frames" frames into "buffers" from offset "done" on.
+  // Returns the number read, or a negative error.
+  snd_pcm_sframes_t ReadMmap(short *const *buffers, int done, int frames);
+  snd_pcm_sframes_t ReadCopy(short *const *buffers, int done, int frames);
+
+  snd_pcm_t *const handle_;
+  const unsigned int sample_rate_;
+  const int channels_;
+  const int period_frames_;
+  const int buffer_frames_;
+  const bool mmap_;
+  std::vector<short> interleaved_;   // Without mmap; a period.
+  const int interrupt_fd_;           // eventfd to stop waiting.
+  std::vector<struct pollfd> pollfds_;   // The device's, then ours.
+  std::atomic<int> xruns_;
+  int last_error_;
+};
+
+#endif  // PITCH_HERO_ALSA_CAPTURE_H
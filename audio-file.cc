@@ -0,0 +1,115 @@
+#include "audio-file.h"
+
+#include <stdint.h>
+#include <string.h>
+
+// Little endian helpers; the WAV header is always little endian.
+static uint32_t le32(const unsigned char *p) {
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+static uint16_t le16(const unsigned char *p) {
+  return p[0] | (p[1] << 8);
+}
+
+AudioFile *AudioFile::Open(const char *filename,
+                           unsigned int raw_rate, int raw_channels) {
+  const bool is_stdin = (strcmp(filename, "-") == 0);
+  FILE *in = is_stdin ? stdin : fopen(filename, "rb");
+  if (in == NULL) {
+    perror(filename);
+    return NULL;
+  }
+  AudioFile *result = new AudioFile(in, !is_stdin);
+  if (!result->ParseHeader(raw_rate, raw_channels)) {
+    fprintf(stderr, "%s: not a 16 bit PCM file we understand.\n", filename);
+    delete result;
+    return NULL;
+  }
+  return result;
+}
+
+AudioFile::AudioFile(FILE *in, bool close_on_exit)
+  : in_(in), close_on_exit_(close_on_exit), sample_rate_(0), channels_(0),
+    remaining_bytes_(-1), pushback_len_(0), pushback_pos_(0) {
+}
+
+AudioFile::~AudioFile() {
+  if (close_on_exit_) fclose(in_);
+}
+
+size_t AudioFile::ReadBytes(void *buffer, size_t len) {
+  unsigned char *out = (unsigned char*) buffer;
+  size_t got = 0;
+  while (pushback_pos_ < pushback_len_ && got < len) {
+    out[got++] = pushback_[pushback_pos_++];
+  }
+  if (got < len) got += fread(out + got, 1, len - got, in_);
+  return got;
+}
+
+bool AudioFile::SkipBytes(size_t len) {
+  unsigned char scratch[512];
+  while (len > 0) {
+    const size_t chunk = len < sizeof(scratch) ? len : sizeof(scratch);
+    if (ReadBytes(scratch, chunk) != chunk) return false;
+    len -= chunk;
+  }
+  return true;
+}
+
+bool AudioFile::ParseHeader(unsigned int raw_rate, int raw_channels) {
+  pushback_len_ = fread(pushback_, 1, sizeof(pushback_), in_);
+  if (pushback_len_ < 12
+      || memcmp(pushback_, "RIFF", 4) != 0
+      || memcmp(pushback_ + 8, "WAVE", 4) != 0) {
+    // Not a WAV file. Everything we read so far is sample data.
+    sample_rate_ = raw_rate;
+    channels_ = raw_channels;
+    remaining_bytes_ = -1;
+    return channels_ > 0;
+  }
+  pushback_pos_ = pushback_len_;   // consumed the RIFF header.
+
+  bool have_format = false;
+  unsigned char chunk_header[8];
+  while (ReadBytes(chunk_header, 8) == 8) {
+    const uint32_t chunk_len = le32(chunk_header + 4);
+    if (memcmp(chunk_header, "fmt ", 4) == 0) {
+      unsigned char fmt[40];
+      if (chunk_len < 16 || chunk_len > sizeof(fmt)) return false;
+      if (ReadBytes(fmt, chunk_len) != chunk_len) return false;
+      const uint16_t format = le16(fmt);
+      const uint16_t bits = le16(fmt + 14);
+      // 1 is plain PCM; 0xFFFE is WAVE_FORMAT_EXTENSIBLE, in which the
+      // sub-format starts with the same format tag.
+      const bool is_pcm = (format == 1)
+        || (format == 0xFFFE && chunk_len >= 26 && le16(fmt + 24) == 1);
+      if (!is_pcm || bits != 16) return false;
+      channels_ = le16(fmt + 2);
+      sample_rate_ = le32(fmt + 4);
+      have_format = true;
+    }
+    else if (memcmp(chunk_header, "data", 4) == 0) {
+      // Streaming writers put 0 or 0xffffffff here if length is unknown.
+      remaining_bytes_ = (chunk_len == 0 || chunk_len == 0xffffffff)
+        ? -1 : (long) chunk_len;
+      return have_format && channels_ > 0;
+    }
+    else if (!SkipBytes(chunk_len + (chunk_len & 1))) {  // padded to even.
+      return false;
+    }
+  }
+  return false;
+}
+
+int AudioFile::Read(short *buffer, int frames) {
+  const size_t frame_bytes = channels_ * sizeof(short);
+  size_t want = frames * frame_bytes;
+  if (remaining_bytes_ >= 0 && want > (size_t) remaining_bytes_) {
+    want = remaining_bytes_ - remaining_bytes_ % frame_bytes;
+  }
+  // We assume a little endian host, so S16_LE can be used as-is.
+  const size_t got = ReadBytes(buffer, want);
+  if (remaining_bytes_ >= 0) remaining_bytes_ -= got;
+  return got / frame_bytes;
+}
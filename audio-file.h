@@ -0,0 +1,44 @@
+#ifndef PITCH_HERO_AUDIO_FILE_H
+#define PITCH_HERO_AUDIO_FILE_H
+
+#include <stdio.h>
+
+// Reads 16 bit signed little endian samples from a WAV file or a raw
+// S16_LE stream. Works on non-seekable input such as stdin, so the
+// WAV header is parsed strictly sequentially.
+class AudioFile {
+public:
+  // Open "filename" ("-" for stdin). If the input does not start with a
+  // RIFF/WAVE header, it is taken as raw S16_LE with the given sample rate
+  // and channel count. Returns NULL and prints a message on failure.
+  static AudioFile *Open(const char *filename,
+                         unsigned int raw_rate, int raw_channels);
+  ~AudioFile();
+
+  unsigned int sample_rate() const { return sample_rate_; }
+  int channels() const { return channels_; }
+
+  // Read up to "frames" interleaved frames into "buffer". Returns number
+  // of frames read; 0 at end of file.
+  int Read(short *buffer, int frames);
+
+private:
+  AudioFile(FILE *in, bool close_on_exit);
+  bool ParseHeader(unsigned int raw_rate, int raw_channels);
+  size_t ReadBytes(void *buffer, size_t len);
+  bool SkipBytes(size_t len);
+
+  FILE *const in_;
+  const bool close_on_exit_;
+  unsigned int sample_rate_;
+  int channels_;
+  long remaining_bytes_;   // in data chunk; -1 for raw streams.
+
+  // Bytes we had to look at to detect the file type, but which turned out
+  // to be sample data of a raw stream.
+  unsigned char pushback_[12];
+  size_t pushback_len_;
+  size_t pushback_pos_;
+};
+
+#endif  // PITCH_HERO_AUDIO_FILE_H
@@ -26,8 +26,18 @@
 
 #include "dywapitchtrack.h"
 #include <math.h>
+#include <pthread.h>
+#include <stdint.h>
 #include <stdlib.h>
-#include <string.h> // for memset
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define DYWA_X86 1
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#define DYWA_NEON 1
+#endif
 
 
 //**********************
@@ -80,6 +90,33 @@ int _iabs(int x) {
 	return -x;
 }
 
+// sorts a in place. Unlike qsort(), which may allocate a buffer for
+// larger arrays, this never allocates (heapsort)
+static void _dywapitch_sortints(int *a, int n) {
+	int start = n/2, end = n;
+	while (end > 1) {
+		int root, child, x;
+		if (start > 0) {
+			// building the heap
+			start--;
+		} else {
+			// move the largest to the end
+			end--;
+			x = a[end]; a[end] = a[0]; a[0] = x;
+		}
+		// sift down a[start]
+		root = start;
+		x = a[root];
+		while ((child = 2*root + 1) < end) {
+			if (child + 1 < end && a[child + 1] > a[child]) child++;
+			if (a[child] <= x) break;
+			a[root] = a[child];
+			root = child;
+		}
+		a[root] = x;
+	}
+}
+
 // 2 power
 int _2power(int i) {
 	int res = 1, j;
@@ -87,12 +124,492 @@ int _2power(int i) {
 	return res;
 }
 
+// where an extremum really is : the vertex of the parabola through the sample
+// at it and its two neighbours, from the sample after it, which is the index
+// the extremum search records. The raw samples are used, so all sample
+// representations agree; the DC does not change where the vertex is.
+static double _dywapitch_vertex(double before, double at, double after) {
+	double curvature = before - 2*at + after;
+	double vertex = (curvature != 0) ? 0.5*(before - after)/curvature : 0.0;
+	return vertex - 1;
+}
+
+//******************************
+// vectorized scanning kernels
+//******************************
+
+/***
+The two loops over all samples of a level are done by kernels that use
+the widest SIMD instructions available at runtime:
+ - the DC and amplitude scan: sum, min and max of the samples.
+ - the extremum search: instead of running the state machine on every
+ sample, a kernel computes in bulk for which indices anything can happen
+ (a zero crossing, or an extremum loud enough) and compacts these into an
+ index list. The state machine then only visits these few candidates.
+ The candidates are computed with the same floating point operations as
+ the scalar code, so the resulting mins and maxs are exactly the same.
+The sum is done in several lanes, so for arbitrary doubles the DC can
+differ in the last bit from a sequential sum. For samples converted from
+16 bit, all partial sums are exact and so is the DC.
+***/
+
+// is anything to do at index i (i >= 2) in the extremum search ?
+static int _dywapitch_iscandidate(const double *sam, int i, double theDC, double threshold) {
+	double si = sam[i] - theDC;
+	double si1 = sam[i-1] - theDC;
+	if (si1 <= 0 && si > 0) return 1;
+	if (si1 >= 0 && si < 0) return 1;
+	if (i < 3) return 0;  // no previous derivative yet
+	double dv = si - si1;
+	double previousDV = si1 - (sam[i-2] - theDC);
+	if (!(previousDV > -1000)) return 0;
+	if (fabs(si) < threshold) return 0;
+	return (previousDV < 0 && dv >= 0) || (previousDV > 0 && dv <= 0);
+}
+
+static void _dywapitch_scan_scalar(const double *sam, int n, double *sum, double *minValue, double *maxValue) {
+	int i;
+	double si;
+	for (i = 0; i < n; i++) {
+		si = sam[i];
+		*sum = *sum + si;
+		if (si > *maxValue) *maxValue = si;
+		if (si < *minValue) *minValue = si;
+	}
+}
+
+static int _dywapitch_candidates_scalar(const double *sam, int n, double theDC, double threshold, int *out) {
+	int i, count = 0;
+	for (i = 2; i < n; i++) {
+		if (_dywapitch_iscandidate(sam, i, theDC, threshold)) out[count++] = i;
+	}
+	return count;
+}
+
+// append index + bit position for each bit in mask
+#define DYWA_COMPACT(mask, index, out, count) \
+	while (mask) { out[count++] = (index) + __builtin_ctz(mask); mask &= mask - 1; }
+
+#ifdef DYWA_X86
+static void _dywapitch_scan_sse2(const double *sam, int n, double *sum, double *minValue, double *maxValue) {
+	__m128d vsum = _mm_setzero_pd();
+	__m128d vmin = _mm_set1_pd(*minValue);
+	__m128d vmax = _mm_set1_pd(*maxValue);
+	double lanes[2];
+	int i;
+	for (i = 0; i + 2 <= n; i += 2) {
+		__m128d v = _mm_loadu_pd(sam + i);
+		vsum = _mm_add_pd(vsum, v);
+		vmin = _mm_min_pd(v, vmin);   // keeps vmin if v is NaN, as the scalar code
+		vmax = _mm_max_pd(v, vmax);
+	}
+	_mm_storeu_pd(lanes, vsum); *sum += lanes[0] + lanes[1];
+	_mm_storeu_pd(lanes, vmin); *minValue = min(lanes[0], lanes[1]);
+	_mm_storeu_pd(lanes, vmax); *maxValue = max(lanes[0], lanes[1]);
+	_dywapitch_scan_scalar(sam + i, n - i, sum, minValue, maxValue);
+}
+
+static int _dywapitch_candidates_sse2(const double *sam, int n, double theDC, double threshold, int *out) {
+	int i, count = 0;
+	if (n > 2 && _dywapitch_iscandidate(sam, 2, theDC, threshold)) out[count++] = 2;
+	const __m128d dc = _mm_set1_pd(theDC);
+	const __m128d zero = _mm_setzero_pd();
+	const __m128d thr = _mm_set1_pd(threshold);
+	const __m128d sentinel = _mm_set1_pd(-1000);
+	const __m128d sign = _mm_set1_pd(-0.0);
+	for (i = 3; i + 2 <= n; i += 2) {
+		__m128d si = _mm_sub_pd(_mm_loadu_pd(sam + i), dc);
+		__m128d si1 = _mm_sub_pd(_mm_loadu_pd(sam + i - 1), dc);
+		__m128d si2 = _mm_sub_pd(_mm_loadu_pd(sam + i - 2), dc);
+		__m128d dv = _mm_sub_pd(si, si1);
+		__m128d pdv = _mm_sub_pd(si1, si2);
+		__m128d up = _mm_and_pd(_mm_cmple_pd(si1, zero), _mm_cmpgt_pd(si, zero));
+		__m128d down = _mm_and_pd(_mm_cmpge_pd(si1, zero), _mm_cmplt_pd(si, zero));
+		__m128d mins = _mm_and_pd(_mm_cmplt_pd(pdv, zero), _mm_cmpge_pd(dv, zero));
+		__m128d maxs = _mm_and_pd(_mm_cmpgt_pd(pdv, zero), _mm_cmple_pd(dv, zero));
+		__m128d loud = _mm_and_pd(_mm_cmpge_pd(_mm_andnot_pd(sign, si), thr),
+		                          _mm_cmpgt_pd(pdv, sentinel));
+		__m128d any = _mm_or_pd(_mm_or_pd(up, down), _mm_and_pd(_mm_or_pd(mins, maxs), loud));
+		unsigned int mask = _mm_movemask_pd(any);
+		DYWA_COMPACT(mask, i, out, count);
+	}
+	for (; i < n; i++) {
+		if (_dywapitch_iscandidate(sam, i, theDC, threshold)) out[count++] = i;
+	}
+	return count;
+}
+
+__attribute__((target("avx2")))
+static void _dywapitch_scan_avx2(const double *sam, int n, double *sum, double *minValue, double *maxValue) {
+	__m256d vsum = _mm256_setzero_pd();
+	__m256d vmin = _mm256_set1_pd(*minValue);
+	__m256d vmax = _mm256_set1_pd(*maxValue);
+	double lanes[4];
+	int i;
+	for (i = 0; i + 4 <= n; i += 4) {
+		__m256d v = _mm256_loadu_pd(sam + i);
+		vsum = _mm256_add_pd(vsum, v);
+		vmin = _mm256_min_pd(v, vmin);
+		vmax = _mm256_max_pd(v, vmax);
+	}
+	_mm256_storeu_pd(lanes, vsum); *sum += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+	_mm256_storeu_pd(lanes, vmin); *minValue = min(min(lanes[0], lanes[1]), min(lanes[2], lanes[3]));
+	_mm256_storeu_pd(lanes, vmax); *maxValue = max(max(lanes[0], lanes[1]), max(lanes[2], lanes[3]));
+	_mm256_zeroupper();
+	_dywapitch_scan_scalar(sam + i, n - i, sum, minValue, maxValue);
+}
+
+__attribute__((target("avx2")))
+static int _dywapitch_candidates_avx2(const double *sam, int n, double theDC, double threshold, int *out) {
+	int i, count = 0;
+	if (n > 2 && _dywapitch_iscandidate(sam, 2, theDC, threshold)) out[count++] = 2;
+	const __m256d dc = _mm256_set1_pd(theDC);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d thr = _mm256_set1_pd(threshold);
+	const __m256d sentinel = _mm256_set1_pd(-1000);
+	const __m256d sign = _mm256_set1_pd(-0.0);
+	for (i = 3; i + 4 <= n; i += 4) {
+		__m256d si = _mm256_sub_pd(_mm256_loadu_pd(sam + i), dc);
+		__m256d si1 = _mm256_sub_pd(_mm256_loadu_pd(sam + i - 1), dc);
+		__m256d si2 = _mm256_sub_pd(_mm256_loadu_pd(sam + i - 2), dc);
+		__m256d dv = _mm256_sub_pd(si, si1);
+		__m256d pdv = _mm256_sub_pd(si1, si2);
+		__m256d up = _mm256_and_pd(_mm256_cmp_pd(si1, zero, _CMP_LE_OQ), _mm256_cmp_pd(si, zero, _CMP_GT_OQ));
+		__m256d down = _mm256_and_pd(_mm256_cmp_pd(si1, zero, _CMP_GE_OQ), _mm256_cmp_pd(si, zero, _CMP_LT_OQ));
+		__m256d mins = _mm256_and_pd(_mm256_cmp_pd(pdv, zero, _CMP_LT_OQ), _mm256_cmp_pd(dv, zero, _CMP_GE_OQ));
+		__m256d maxs = _mm256_and_pd(_mm256_cmp_pd(pdv, zero, _CMP_GT_OQ), _mm256_cmp_pd(dv, zero, _CMP_LE_OQ));
+		__m256d loud = _mm256_and_pd(_mm256_cmp_pd(_mm256_andnot_pd(sign, si), thr, _CMP_GE_OQ),
+		                             _mm256_cmp_pd(pdv, sentinel, _CMP_GT_OQ));
+		__m256d any = _mm256_or_pd(_mm256_or_pd(up, down), _mm256_and_pd(_mm256_or_pd(mins, maxs), loud));
+		unsigned int mask = _mm256_movemask_pd(any);
+		DYWA_COMPACT(mask, i, out, count);
+	}
+	// the tail calls non-AVX code; don't make it pay for dirty upper registers
+	_mm256_zeroupper();
+	for (; i < n; i++) {
+		if (_dywapitch_iscandidate(sam, i, theDC, threshold)) out[count++] = i;
+	}
+	return count;
+}
+#endif  // DYWA_X86
+
+#ifdef DYWA_NEON
+static void _dywapitch_scan_neon(const double *sam, int n, double *sum, double *minValue, double *maxValue) {
+	float64x2_t vsum = vdupq_n_f64(0.0);
+	float64x2_t vmin = vdupq_n_f64(*minValue);
+	float64x2_t vmax = vdupq_n_f64(*maxValue);
+	int i;
+	for (i = 0; i + 2 <= n; i += 2) {
+		float64x2_t v = vld1q_f64(sam + i);
+		vsum = vaddq_f64(vsum, v);
+		// select explicitly, so that NaN samples are skipped as in the scalar code
+		vmin = vbslq_f64(vcltq_f64(v, vmin), v, vmin);
+		vmax = vbslq_f64(vcgtq_f64(v, vmax), v, vmax);
+	}
+	*sum += vgetq_lane_f64(vsum, 0) + vgetq_lane_f64(vsum, 1);
+	*minValue = min(vgetq_lane_f64(vmin, 0), vgetq_lane_f64(vmin, 1));
+	*maxValue = max(vgetq_lane_f64(vmax, 0), vgetq_lane_f64(vmax, 1));
+	_dywapitch_scan_scalar(sam + i, n - i, sum, minValue, maxValue);
+}
+
+static int _dywapitch_candidates_neon(const double *sam, int n, double theDC, double threshold, int *out) {
+	int i, count = 0;
+	if (n > 2 && _dywapitch_iscandidate(sam, 2, theDC, threshold)) out[count++] = 2;
+	const float64x2_t dc = vdupq_n_f64(theDC);
+	const float64x2_t zero = vdupq_n_f64(0.0);
+	const float64x2_t thr = vdupq_n_f64(threshold);
+	const float64x2_t sentinel = vdupq_n_f64(-1000);
+	for (i = 3; i + 2 <= n; i += 2) {
+		float64x2_t si = vsubq_f64(vld1q_f64(sam + i), dc);
+		float64x2_t si1 = vsubq_f64(vld1q_f64(sam + i - 1), dc);
+		float64x2_t si2 = vsubq_f64(vld1q_f64(sam + i - 2), dc);
+		float64x2_t dv = vsubq_f64(si, si1);
+		float64x2_t pdv = vsubq_f64(si1, si2);
+		uint64x2_t up = vandq_u64(vcleq_f64(si1, zero), vcgtq_f64(si, zero));
+		uint64x2_t down = vandq_u64(vcgeq_f64(si1, zero), vcltq_f64(si, zero));
+		uint64x2_t mins = vandq_u64(vcltq_f64(pdv, zero), vcgeq_f64(dv, zero));
+		uint64x2_t maxs = vandq_u64(vcgtq_f64(pdv, zero), vcleq_f64(dv, zero));
+		uint64x2_t loud = vandq_u64(vcgeq_f64(vabsq_f64(si), thr), vcgtq_f64(pdv, sentinel));
+		uint64x2_t any = vorrq_u64(vorrq_u64(up, down), vandq_u64(vorrq_u64(mins, maxs), loud));
+		unsigned int mask = (vgetq_lane_u64(any, 0) & 1) | ((vgetq_lane_u64(any, 1) & 1) << 1);
+		DYWA_COMPACT(mask, i, out, count);
+	}
+	for (; i < n; i++) {
+		if (_dywapitch_iscandidate(sam, i, theDC, threshold)) out[count++] = i;
+	}
+	return count;
+}
+#endif  // DYWA_NEON
+
+typedef void (*_dywapitch_scanfn)(const double *sam, int n, double *sum, double *minValue, double *maxValue);
+typedef void (*_dywapitch_extremafn)(const void *sam, int n, double theDC, double threshold, int delta,
+                                     struct _dywapitchtracker *t, int *nbMins, int *nbMaxs);
+typedef void (*_dywapitch_downsamplefn)(const void *src, int n, void *dst);
+typedef int (*_dywapitch_candidatefn)(const double *sam, int n, double theDC, double threshold, int *out);
+
+static _dywapitch_scanfn _dywapitch_scan = _dywapitch_scan_scalar;
+static _dywapitch_candidatefn _dywapitch_candidates = _dywapitch_candidates_scalar;
+
+// pick the best kernels for this CPU; only through _dywapitch_selectkernels(), as
+// other threads may be running the kernels already
+static void _dywapitch_selectkernelsonce(void) {
+#if defined(DYWA_X86)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		_dywapitch_scan = _dywapitch_scan_avx2;
+		_dywapitch_candidates = _dywapitch_candidates_avx2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		_dywapitch_scan = _dywapitch_scan_sse2;
+		_dywapitch_candidates = _dywapitch_candidates_sse2;
+	}
+#elif defined(DYWA_NEON)
+	_dywapitch_scan = _dywapitch_scan_neon;
+	_dywapitch_candidates = _dywapitch_candidates_neon;
+#endif
+}
+
+static void _dywapitch_selectkernels(void) {
+	static pthread_once_t once = PTHREAD_ONCE_INIT;
+	pthread_once(&once, _dywapitch_selectkernelsonce);
+}
+
+// the extremum search on doubles, using the vectorized candidate kernels
+static void _dywapitch_extrema_d(const void *samples, int curSamNb, double theDC, double ampltitudeThreshold, int delta,
+                                 dywapitchtracker *t, int *nbMinsOut, int *nbMaxsOut) {
+	const double *sam = (const double *)samples;
+	int i, nbMins = 0, nbMaxs = 0;
+	double si, si1;
+	double dv, previousDV = -1000;
+	int lastMinIndex = -1000000;
+	int lastmaxIndex = -1000000;
+	int findMax = 0;
+	int findMin = 0;
+	// only visit the indices where something can happen
+	int c, nbCandidates = _dywapitch_candidates(sam, curSamNb, theDC, ampltitudeThreshold, t->_candidates);
+	for (c = 0; c < nbCandidates; c++) {
+		i = t->_candidates[c];
+		si = sam[i] - theDC;
+		si1 = sam[i-1] - theDC;
+		
+		if (si1 <= 0 && si > 0) findMax = 1;
+		if (si1 >= 0 && si < 0) findMin = 1;
+		
+		// min or max ?
+		dv = si - si1;
+		// the derivative of the previous sample; none for the first one
+		previousDV = (i > 2) ? si1 - (sam[i-2] - theDC) : -1000;
+		
+		if (previousDV > -1000) {
+			
+			if (findMin && previousDV < 0 && dv >= 0) { 
+				// minimum
+				if (fabs(si) >= ampltitudeThreshold) {
+					if (i > lastMinIndex + delta) {
+						t->_minOffsets[nbMins] = _dywapitch_vertex(sam[i-2], sam[i-1], sam[i]);
+						t->_mins[nbMins++] = i;
+						lastMinIndex = i;
+						findMin = 0;
+						//if DEBUGG then put "min ok"&&si
+						//
+					} else {
+						//if DEBUGG then put "min too close to previous"&&(i - lastMinIndex)
+						//
+					}
+				} else {
+					// if DEBUGG then put "min "&abs(si)&" < thresh = "&ampltitudeThreshold
+					//--
+				}
+			}
+			
+			if (findMax && previousDV > 0 && dv <= 0) {
+				// maximum
+				if (fabs(si) >= ampltitudeThreshold) {
+					if (i > lastmaxIndex + delta) {
+						t->_maxOffsets[nbMaxs] = _dywapitch_vertex(sam[i-2], sam[i-1], sam[i]);
+						t->_maxs[nbMaxs++] = i;
+						lastmaxIndex = i;
+						findMax = 0;
+					} else {
+						//if DEBUGG then put "max too close to previous"&&(i - lastmaxIndex)
+						//--
+					}
+				} else {
+					//if DEBUGG then put "max "&abs(si)&" < thresh = "&ampltitudeThreshold
+					//--
+				}
+			}
+		}
+	}
+	*nbMinsOut = nbMins;
+	*nbMaxsOut = nbMaxs;
+}
+
+//******************************
+// incremental analysis
+//******************************
+
+/***
+When the window slides over a stream, most of it has been seen in the
+previous call already. The downsampled levels of a window that moved by a
+multiple of 2^(levels-1) samples are the same as those of the stream, so
+each level can be kept as a stream too, only appending the new samples.
+The extremum search depends on the DC of the whole window though, so it
+can't be kept. But only the turning points of the signal, where the sign of
+the derivative changes, can become extrema, and between them the signal is
+monotonic: where it crosses the DC can be told from the turning points
+alone. So we keep the turning points of each level, and the extremum search
+only visits those.
+***/
+
+// number of wavelet levels the algorithm goes down at most
+#define DYWA_MAX_FLWT_LEVELS 6
+
+// the windows have to move by a multiple of this for the levels to line up
+#define DYWA_INCREMENTAL_STEP (1 << (DYWA_MAX_FLWT_LEVELS - 1))
+
+typedef struct {
+	long long pos;     // in the stream of the level
+	int isMax;         // else a minimum
+	double value;      // the sample at pos
+	double prevValue;  // and the one before; the extremum is there
+	double prevPrevValue;  // and the one before that
+} _dywapitch_turn;
+
+typedef struct {
+	long long count;   // samples of this level so far
+	double last[2];    // the last two of them, the newest last
+	double *values;    // ring of the newest samples
+	int valueMask;
+	_dywapitch_turn *turns;  // ring of the turning points in the window
+	int turnMask;
+	long long firstTurn, endTurn;
+} _dywapitch_levelstream;
+
+struct _dywapitch_incremental {
+	_dywapitch_levelstream levels[DYWA_MAX_FLWT_LEVELS];
+	long long *stepSums;   // ring of the sums of DYWA_INCREMENTAL_STEP samples of level 0
+	int stepMask;
+	long long sum;         // of the window
+	int valid;
+	dywapitch_precision precision;  // of the levels kept
+};
+
+//******************************
+// sample representations
+//******************************
+
+/***
+The wavelet levels can be computed in different precisions. The kernels
+that touch samples are generated from dywapitchtrack_kernel.h for each
+pair of element and computation type; the level loop in
+_dywapitch_computeWaveletPitch is shared.
+ - double: the reference. The double input path uses the SIMD kernels,
+ which rely on samples in [-1, 1] (see the -1000 sentinel); d_any works
+ at any scale, as needed for 16 bit samples.
+ - float: half the memory bandwidth, same accuracy for 16 bit input.
+ - fixed: integer only. Instead of averages, the downsampled levels hold
+ the sums of 2, 4, ... samples, so they are exact; DC and threshold
+ are scaled up accordingly.
+16 bit samples are consumed directly at level 0, without converting them
+first.
+***/
+
+#define DYWA_ELEM double
+#define DYWA_CT double
+#define DYWA_LEVEL double
+#define DYWA_TURNS 1
+#define DYWA_SUFFIX d_any
+#include "dywapitchtrack_kernel.h"
+
+#define DYWA_ELEM short
+#define DYWA_CT double
+#define DYWA_LEVEL double
+#define DYWA_SUFFIX s16_d
+#include "dywapitchtrack_kernel.h"
+
+#define DYWA_ELEM short
+#define DYWA_CT float
+#define DYWA_LEVEL float
+#define DYWA_SUFFIX s16_f
+#include "dywapitchtrack_kernel.h"
+
+#define DYWA_ELEM float
+#define DYWA_CT float
+#define DYWA_LEVEL float
+#define DYWA_TURNS 1
+#define DYWA_SUFFIX f
+#include "dywapitchtrack_kernel.h"
+
+#define DYWA_ELEM short
+#define DYWA_CT int32_t
+#define DYWA_LEVEL int32_t
+#define DYWA_FIXED 1
+#define DYWA_SUFFIX s16_i
+#include "dywapitchtrack_kernel.h"
+
+#define DYWA_ELEM int32_t
+#define DYWA_CT int32_t
+#define DYWA_LEVEL int32_t
+#define DYWA_FIXED 1
+#define DYWA_TURNS 1
+#define DYWA_SUFFIX i
+#include "dywapitchtrack_kernel.h"
+
+// DC and amplitude threshold of 16 bit samples. The sum is exact.
+static void _dywapitch_stats_s16(const short *sam, int n, double *theDC, double *amplitudeMax) {
+	int64_t sum = 0;
+	int maxValue = 0, minValue = 0, i;
+	for (i = 0; i < n; i++) {
+		sum += sam[i];
+		if (sam[i] > maxValue) maxValue = sam[i];
+		if (sam[i] < minValue) minValue = sam[i];
+	}
+	*theDC = (double)sum / n;
+	double maxV = maxValue - *theDC;
+	double minV = minValue - *theDC;
+	*amplitudeMax = (maxV > -minV ? maxV : -minV);
+}
+
+typedef void (*_dywapitch_advancefn)(const void *src, int n, _dywapitch_levelstream *ls, void *dst);
+typedef void (*_dywapitch_turnsfn)(const _dywapitch_levelstream *ls, int n, double theDC, double threshold, int delta,
+                                   struct _dywapitchtracker *t, int *nbMins, int *nbMaxs);
+
+typedef struct {
+	_dywapitch_extremafn extrema0;      // on level 0, the caller's samples
+	_dywapitch_extremafn extrema;       // on the downsampled levels
+	_dywapitch_downsamplefn downsample0;
+	_dywapitch_downsamplefn downsample;
+	int levelSize;   // bytes per sample in the downsampled levels
+	int sumLevels;   // levels hold sums instead of averages
+	// incremental analysis, 16 bit samples only
+	_dywapitch_advancefn advance0;
+	_dywapitch_advancefn advance;
+	_dywapitch_turnsfn turns;
+} _dywapitch_kernel;
+
+static const _dywapitch_kernel _dywapitch_kernel_d = {
+	_dywapitch_extrema_d, _dywapitch_extrema_d,
+	_dywapitch_downsample_d_any, _dywapitch_downsample_d_any, sizeof(double), 0,
+	NULL, NULL, NULL };
+static const _dywapitch_kernel _dywapitch_kernels_s16[] = {
+	// indexed by dywapitch_precision
+	{ _dywapitch_extrema_s16_d, _dywapitch_extrema_d_any,
+	  _dywapitch_downsample_s16_d, _dywapitch_downsample_d_any, sizeof(double), 0,
+	  _dywapitch_advance_s16_d, _dywapitch_advance_d_any, _dywapitch_turns_d_any },
+	{ _dywapitch_extrema_s16_f, _dywapitch_extrema_f,
+	  _dywapitch_downsample_s16_f, _dywapitch_downsample_f, sizeof(float), 0,
+	  _dywapitch_advance_s16_f, _dywapitch_advance_f, _dywapitch_turns_f },
+	{ _dywapitch_extrema_s16_i, _dywapitch_extrema_i,
+	  _dywapitch_downsample_s16_i, _dywapitch_downsample_i, sizeof(int32_t), 1,
+	  _dywapitch_advance_s16_i, _dywapitch_advance_i, _dywapitch_turns_i },
+};
+
 //******************************
 // the Wavelet algorithm itself
 //******************************
 
-int dywapitch_neededsamplecount(int minFreq) {
-	int nbSam = 3*44100/minFreq; // 1017. for 130 Hz
+int dywapitch_neededsamplecount(int minFreq, int samplerate) {
+	int nbSam = 3*samplerate/minFreq; // 1017. for 130 Hz at 44100 Hz
 	nbSam = _ceil_power2(nbSam); // 1024
 	return nbSam;
 }
@@ -102,44 +619,34 @@ typedef struct _minmax {
 	struct _minmax *next;
 } minmax;
 
-double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, double *sam) {
+// the level loop, shared by all sample representations. Level 0 is in
+// "samples", theDC and amplitudeMax have been computed from it.
+// With "inc", the levels are not computed but taken from the streams kept
+// for the incremental analysis; "samples" is not used then.
+static double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, const _dywapitch_kernel *k,
+                                             const void *samples, double theDC, double amplitudeMax,
+                                             const struct _dywapitch_incremental *inc) {
 	double pitchF = 0.0;
 	
+	// the signal of the current level. Level 0 is the caller's buffer, which
+	// we don't touch; the downsampled levels go to the tracker's pyramid.
+	const void *sam = samples;
+	char *nextLevel = (char *)t->_levels;
+	
 	int i, j;
-	double si, si1;
 	
 	int curSamNb = t->_samplecount;
 	
 	int nbMins, nbMaxs;
 	
 	// algorithm parameters
-	int maxFLWTlevels = 6;
+	int maxFLWTlevels = DYWA_MAX_FLWT_LEVELS;
 	double maxF = 3000.;
 	int differenceLevelsN = 3;
 	double maximaThresholdRatio = 0.75;
 	
-	double ampltitudeThreshold;  
-	double theDC = 0.0;
-	
-	{ // compute ampltitudeThreshold and theDC
-		//first compute the DC and maxAMplitude
-		double maxValue = 0.0;
-		double minValue = 0.0;
-		for (i = 0; i < t->_samplecount;i++) {
-			si = sam[i];
-			theDC = theDC + si;
-			if (si > maxValue) maxValue = si;
-			if (si < minValue) minValue = si;
-		}
-		theDC = theDC/t->_samplecount;
-		maxValue = maxValue - theDC;
-		minValue = minValue - theDC;
-		double amplitudeMax = (maxValue > -minValue ? maxValue : -minValue);
-		
-		ampltitudeThreshold = amplitudeMax*maximaThresholdRatio;
-		//asLog("dywapitch theDC=%f ampltitudeThreshold=%f\n", theDC, ampltitudeThreshold);
-		
-	}
+	double ampltitudeThreshold = amplitudeMax*maximaThresholdRatio;
+	//asLog("dywapitch theDC=%f ampltitudeThreshold=%f\n", theDC, ampltitudeThreshold);
 	
 	// levels, start without downsampling..
 	int curLevel = 0;
@@ -147,9 +654,10 @@ double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, double *sam)
 	int delta;
 	
 	while(1) {
+		t->_levelsUsed = curLevel + 1;
 		
 		// delta
-		delta = 44100./(_2power(curLevel)*maxF);
+		delta = t->_samplerate/(_2power(curLevel)*maxF);
 		//("dywapitch doing level=%ld delta=%ld\n", curLevel, delta);
 		
 		if (curSamNb < 2) goto cleanup;
@@ -157,62 +665,12 @@ double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, double *sam)
 		// compute the first maximums and minumums after zero-crossing
 		// store if greater than the min threshold
 		// and if at a greater distance than delta
-		double dv, previousDV = -1000;
-		nbMins = nbMaxs = 0;   
-		int lastMinIndex = -1000000;
-		int lastmaxIndex = -1000000;
-		int findMax = 0;
-		int findMin = 0;
-		for (i = 2; i < curSamNb; i++) {
-			si = sam[i] - theDC;
-			si1 = sam[i-1] - theDC;
-			
-			if (si1 <= 0 && si > 0) findMax = 1;
-			if (si1 >= 0 && si < 0) findMin = 1;
-			
-			// min or max ?
-			dv = si - si1;
-			
-			if (previousDV > -1000) {
-				
-				if (findMin && previousDV < 0 && dv >= 0) { 
-					// minimum
-					if (fabs(si) >= ampltitudeThreshold) {
-						if (i > lastMinIndex + delta) {
-							t->_mins[nbMins++] = i;
-							lastMinIndex = i;
-							findMin = 0;
-							//if DEBUGG then put "min ok"&&si
-							//
-						} else {
-							//if DEBUGG then put "min too close to previous"&&(i - lastMinIndex)
-							//
-						}
-					} else {
-						// if DEBUGG then put "min "&abs(si)&" < thresh = "&ampltitudeThreshold
-						//--
-					}
-				}
-				
-				if (findMax && previousDV > 0 && dv <= 0) {
-					// maximum
-					if (fabs(si) >= ampltitudeThreshold) {
-						if (i > lastmaxIndex + delta) {
-							t->_maxs[nbMaxs++] = i;
-							lastmaxIndex = i;
-							findMax = 0;
-						} else {
-							//if DEBUGG then put "max too close to previous"&&(i - lastmaxIndex)
-							//--
-						}
-					} else {
-						//if DEBUGG then put "max "&abs(si)&" < thresh = "&ampltitudeThreshold
-						//--
-					}
-				}
-			}
-			
-			previousDV = dv;
+		if (inc != NULL) {
+			k->turns(&inc->levels[curLevel], curSamNb, theDC, ampltitudeThreshold, delta, t, &nbMins, &nbMaxs);
+		} else if (curLevel == 0) {
+			k->extrema0(sam, curSamNb, theDC, ampltitudeThreshold, delta, t, &nbMins, &nbMaxs);
+		} else {
+			k->extrema(sam, curSamNb, theDC, ampltitudeThreshold, delta, t, &nbMins, &nbMaxs);
 		}
 		
 		if (nbMins == 0 && nbMaxs == 0) {
@@ -226,14 +684,16 @@ double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, double *sam)
 		
 		// maxs = [5, 20, 100,...]
 		// compute distances
-		int d;
-		memset(t->_distances, 0, t->_samplecount*sizeof(int));
+		// Only a few distances occur, so instead of a histogram over all
+		// possible distances we keep a sorted list of the distinct ones
+		// (t->_distances) with their counts (t->_distanceCounts).
+		int d, nbDistances = 0;
 		for (i = 0 ; i < nbMins ; i++) {
 			for (j = 1; j < differenceLevelsN; j++) {
 				if (i+j < nbMins) {
 					d = _iabs(t->_mins[i] - t->_mins[i+j]);
 					//asLog("dywapitch i=%ld j=%ld d=%ld\n", i, j, d);
-					t->_distances[d] = t->_distances[d] + 1;
+					t->_distances[nbDistances++] = d;
 				}
 			}
 		}
@@ -242,20 +702,40 @@ double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, double *sam)
 				if (i+j < nbMaxs) {
 					d = _iabs(t->_maxs[i] - t->_maxs[i+j]);
 					//asLog("dywapitch i=%ld j=%ld d=%ld\n", i, j, d);
-					t->_distances[d] = t->_distances[d] + 1;
+					t->_distances[nbDistances++] = d;
 				}
 			}
 		}
+		_dywapitch_sortints(t->_distances, nbDistances);
+		int nbDistinct = 0;
+		for (i = 0; i < nbDistances; i++) {
+			if (nbDistinct > 0 && t->_distances[nbDistinct-1] == t->_distances[i]) {
+				t->_distanceCounts[nbDistinct-1]++;
+			} else {
+				t->_distances[nbDistinct] = t->_distances[i];
+				t->_distanceCounts[nbDistinct++] = 1;
+			}
+		}
 		
 		// find best summed distance
+		// The sum of counts within +/- delta of i only changes where a
+		// distance enters (d - delta) or leaves (d + delta + 1) the window,
+		// so we walk from one such event to the next; in between, all i have
+		// the same sum. That gives the same result as looking at every i.
 		int bestDistance = -1;
 		int bestValue = -1;
-		for (i = 0; i< curSamNb; i++) {
-			int summed = 0;
-			for (j = -delta ; j <= delta ; j++) {
-				if (i+j >=0 && i+j < curSamNb)
-					summed += t->_distances[i+j];
-			}
+		int summed = 0;
+		int entering = 0, leaving = 0;
+		i = 0;
+		while (i < curSamNb) {
+			while (entering < nbDistinct && t->_distances[entering] - delta <= i)
+				summed += t->_distanceCounts[entering++];
+			while (leaving < nbDistinct && t->_distances[leaving] + delta + 1 <= i)
+				summed -= t->_distanceCounts[leaving++];
+			int next = curSamNb;
+			if (entering < nbDistinct) next = min(next, t->_distances[entering] - delta);
+			if (leaving < nbDistinct) next = min(next, t->_distances[leaving] + delta + 1);
+			
 			//asLog("dywapitch i=%ld summed=%ld bestDistance=%ld\n", i, summed, bestDistance);
 			if (summed == bestValue) {
 				if (i == 2*bestDistance)
@@ -265,18 +745,38 @@ double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, double *sam)
 				bestValue = summed;
 				bestDistance = i;
 			}
+			// the rest of [i, next) ties with the best value; a tie only wins
+			// at twice the best distance
+			if (summed == bestValue) {
+				while (2*bestDistance > i && 2*bestDistance < next) {
+					bestDistance = 2*bestDistance;
+					i = bestDistance;
+				}
+			}
+			i = next;
 		}
 		//asLog("dywapitch bestDistance=%ld\n", bestDistance);
 		
-		// averaging
+		// averaging, of the distances between the refined extremum positions :
+		// at the downsampled levels, whole samples are too coarse for a stable
+		// pitch, unless the window holds many periods
 		double distAvg = 0.0;
 		double nbDists = 0;
-		for (j = -delta ; j <= delta ; j++) {
-			if (bestDistance+j >=0 && bestDistance+j < t->_samplecount) {
-				int nbDist = t->_distances[bestDistance+j];
-				if (nbDist > 0) {
-					nbDists += nbDist;
-					distAvg += (bestDistance+j)*nbDist;
+		for (i = 0 ; i < nbMins ; i++) {
+			for (j = 1; j < differenceLevelsN && i+j < nbMins; j++) {
+				d = t->_mins[i+j] - t->_mins[i];
+				if (d >= bestDistance - delta && d <= bestDistance + delta) {
+					distAvg += d + t->_minOffsets[i+j] - t->_minOffsets[i];
+					nbDists++;
+				}
+			}
+		}
+		for (i = 0 ; i < nbMaxs ; i++) {
+			for (j = 1; j < differenceLevelsN && i+j < nbMaxs; j++) {
+				d = t->_maxs[i+j] - t->_maxs[i];
+				if (d >= bestDistance - delta && d <= bestDistance + delta) {
+					distAvg += d + t->_maxOffsets[i+j] - t->_maxOffsets[i];
+					nbDists++;
 				}
 			}
 		}
@@ -291,7 +791,7 @@ double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, double *sam)
 				//if DEBUGG then put "similarity="&similarity&&"delta="&delta&&"ok"
  				//asLog("dywapitch similarity=%f OK !\n", similarity);
 				// two consecutive similar mode distances : ok !
-				pitchF = 44100./(_2power(curLevel-1)*curModeDistance);
+				pitchF = t->_samplerate/(_2power(curLevel-1)*curModeDistance);
 				goto cleanup;
 			}
 			//if DEBUGG then put "similarity="&similarity&&"delta="&delta&&"not"
@@ -312,10 +812,21 @@ double _dywapitch_computeWaveletPitch(struct _dywapitchtracker *t, double *sam)
  			//asLog("dywapitch not enough samples, exiting\n");
 			goto cleanup;
 		}
-		for (i = 0; i < curSamNb/2; i++) {
-			sam[i] = (sam[2*i] + sam[2*i + 1])/2.;
+		if (inc == NULL) {
+			if (curLevel == 1) {
+				k->downsample0(sam, curSamNb, nextLevel);
+			} else {
+				k->downsample(sam, curSamNb, nextLevel);
+			}
+			sam = nextLevel;
+			nextLevel += (curSamNb/2) * k->levelSize;
 		}
 		curSamNb /= 2;
+		if (k->sumLevels) {
+			// the level holds sums of twice as many samples as before
+			theDC *= 2;
+			ampltitudeThreshold *= 2;
+		}
 	}
 	
 	///
@@ -338,6 +849,9 @@ It states:
  of a voiced segment. Smooth the plot. 
 ***/
 
+// the confidence of the tracked pitch saturates here; from two below, it is trusted
+#define DYWA_MAX_CONFIDENCE 5
+
 double _dywapitch_dynamicprocess(dywapitchtracker *pitchtracker, double pitch) {
 	
 	// equivalence
@@ -346,7 +860,7 @@ double _dywapitch_dynamicprocess(dywapitchtracker *pitchtracker, double pitch) {
 	//
 	double estimatedPitch = -1;
 	double acceptedError = 0.4f;   // used to be 0.2
-	int maxConfidence = 5;
+	int maxConfidence = DYWA_MAX_CONFIDENCE;
 	
 	if (pitch != -1) {
 		// I have a pitch here
@@ -422,25 +936,225 @@ double _dywapitch_dynamicprocess(dywapitchtracker *pitchtracker, double pitch) {
 // the API main entry points
 // ************************************
 
-void dywapitch_inittracking(dywapitchtracker *pitchtracker, int samplecount) {
+void dywapitch_inittracking(dywapitchtracker *pitchtracker, int samplecount, int samplerate) {
 	samplecount = _floor_power2(samplecount);
 	pitchtracker->_samplecount = samplecount;
-	pitchtracker->_distances = (int *)malloc(sizeof(int)*samplecount);
+	pitchtracker->_samplerate = samplerate;
+	pitchtracker->_precision = DYWAPITCH_DOUBLE;
+	pitchtracker->_levelsUsed = 0;
+	_dywapitch_selectkernels();
+	// each extremum contributes at most two distances
+	pitchtracker->_distances = (int *)malloc(sizeof(int)*2*samplecount);
+	pitchtracker->_distanceCounts = (int *)malloc(sizeof(int)*samplecount);
 	pitchtracker->_mins = (int *)malloc(sizeof(int)*samplecount);
 	pitchtracker->_maxs = (int *)malloc(sizeof(int)*samplecount);
+	pitchtracker->_minOffsets = (double *)malloc(sizeof(double)*samplecount);
+	pitchtracker->_maxOffsets = (double *)malloc(sizeof(double)*samplecount);
+	pitchtracker->_candidates = (int *)malloc(sizeof(int)*samplecount);
+	// levels 1, 2, ... have samplecount/2, samplecount/4, ... samples
+	pitchtracker->_levels = malloc(sizeof(double)*samplecount);
+	// the streams of the incremental analysis hold a window each
+	struct _dywapitch_incremental *inc = (struct _dywapitch_incremental *)malloc(sizeof(struct _dywapitch_incremental));
+	int level;
+	for (level = 0; level < DYWA_MAX_FLWT_LEVELS; level++) {
+		int levelSize = _ceil_power2(max(samplecount >> level, 1));
+		inc->levels[level].values = (double *)malloc(sizeof(double)*levelSize);
+		inc->levels[level].valueMask = levelSize - 1;
+		inc->levels[level].turns = (_dywapitch_turn *)malloc(sizeof(_dywapitch_turn)*levelSize);
+		inc->levels[level].turnMask = levelSize - 1;
+	}
+	int steps = _ceil_power2(max(samplecount / DYWA_INCREMENTAL_STEP, 1));
+	inc->stepSums = (long long *)malloc(sizeof(long long)*steps);
+	inc->stepMask = steps - 1;
+	inc->valid = 0;
+	pitchtracker->_incremental = inc;
+	pitchtracker->_prevPitch = -1.0;
+	pitchtracker->_pitchConfidence = -1;
+}
+
+void dywapitch_initdynamic(dywapitchtracker *pitchtracker) {
+	memset(pitchtracker, 0, sizeof(*pitchtracker));
+	pitchtracker->_precision = DYWAPITCH_DOUBLE;
 	pitchtracker->_prevPitch = -1.0;
 	pitchtracker->_pitchConfidence = -1;
 }
 
 void dywapitch_delete(dywapitchtracker *pitchtracker) {
+	if (pitchtracker->_incremental == NULL) {
+		// from dywapitch_initdynamic
+		return;
+	}
 	free(pitchtracker->_distances);
+	free(pitchtracker->_distanceCounts);
 	free(pitchtracker->_mins);
 	free(pitchtracker->_maxs);
+	free(pitchtracker->_minOffsets);
+	free(pitchtracker->_maxOffsets);
+	free(pitchtracker->_candidates);
+	free(pitchtracker->_levels);
+	int level;
+	for (level = 0; level < DYWA_MAX_FLWT_LEVELS; level++) {
+		free(pitchtracker->_incremental->levels[level].values);
+		free(pitchtracker->_incremental->levels[level].turns);
+	}
+	free(pitchtracker->_incremental->stepSums);
+	free(pitchtracker->_incremental);
+}
+
+void dywapitch_setprecision(dywapitchtracker *pitchtracker, dywapitch_precision precision) {
+	pitchtracker->_precision = precision;
+}
+
+double dywapitch_computerawpitch(dywapitchtracker *pitchtracker, const double * samples) {
+	//first compute the DC and maxAMplitude
+	double theDC = 0.0;
+	double maxValue = 0.0;
+	double minValue = 0.0;
+	_dywapitch_scan(samples, pitchtracker->_samplecount, &theDC, &minValue, &maxValue);
+	theDC = theDC/pitchtracker->_samplecount;
+	maxValue = maxValue - theDC;
+	minValue = minValue - theDC;
+	double amplitudeMax = (maxValue > -minValue ? maxValue : -minValue);
+	return _dywapitch_computeWaveletPitch(pitchtracker, &_dywapitch_kernel_d, samples, theDC, amplitudeMax, NULL);
+}
+
+double dywapitch_computerawpitch_s16(dywapitchtracker *pitchtracker, const short * samples) {
+	double theDC, amplitudeMax;
+	_dywapitch_stats_s16(samples, pitchtracker->_samplecount, &theDC, &amplitudeMax);
+	return _dywapitch_computeWaveletPitch(pitchtracker, &_dywapitch_kernels_s16[pitchtracker->_precision],
+	                                      samples, theDC, amplitudeMax, NULL);
+}
+
+// appends the newest "advanced" samples of the window to the streams of all levels
+static void _dywapitch_advancestreams(dywapitchtracker *t, const _dywapitch_kernel *k,
+                                      const short *samples, int advanced) {
+	struct _dywapitch_incremental *inc = t->_incremental;
+	const int n = t->_samplecount;
+	const short *newSamples = samples + n - advanced;
+	int i, level;
+	
+	// the DC
+	const int nbSteps = advanced / DYWA_INCREMENTAL_STEP;
+	const int windowSteps = n / DYWA_INCREMENTAL_STEP;
+	const long long firstStep = inc->levels[0].count / DYWA_INCREMENTAL_STEP;
+	long long step;
+	for (step = firstStep - windowSteps; step < firstStep + nbSteps - windowSteps; step++) {
+		if (step >= 0) inc->sum -= inc->stepSums[step & inc->stepMask];
+	}
+	for (step = 0; step < nbSteps; step++) {
+		long long sum = 0;
+		for (i = 0; i < DYWA_INCREMENTAL_STEP; i++) {
+			sum += newSamples[step*DYWA_INCREMENTAL_STEP + i];
+		}
+		inc->stepSums[(firstStep + step) & inc->stepMask] = sum;
+		inc->sum += sum;
+	}
+	
+	// the levels; the new samples of each level go to the scratch pyramid
+	const void *src = newSamples;
+	char *dst = (char *)t->_levels;
+	for (level = 0; level < DYWA_MAX_FLWT_LEVELS; level++) {
+		_dywapitch_levelstream *ls = &inc->levels[level];
+		const int levelAdvanced = advanced >> level;
+		// forget the turning points that leave the window; as in the
+		// extremum search, those at index < 3 don't count
+		const long long offset = ls->count + levelAdvanced - (n >> level);
+		while (ls->firstTurn < ls->endTurn && ls->turns[ls->firstTurn & ls->turnMask].pos < offset + 3) {
+			ls->firstTurn++;
+		}
+		const int last = (level == DYWA_MAX_FLWT_LEVELS - 1);
+		if (level == 0) {
+			k->advance0(src, levelAdvanced, ls, last ? NULL : dst);
+		} else {
+			k->advance(src, levelAdvanced, ls, last ? NULL : dst);
+		}
+		src = dst;
+		dst += (levelAdvanced/2) * k->levelSize;
+	}
 }
-double dywapitch_computepitch(dywapitchtracker *pitchtracker, double * samples) {
-	double raw_pitch = _dywapitch_computeWaveletPitch(pitchtracker, samples);
+
+double dywapitch_computerawpitch_incremental_s16(dywapitchtracker *pitchtracker, const short * samples, int advanced) {
+	struct _dywapitch_incremental *inc = pitchtracker->_incremental;
+	const int n = pitchtracker->_samplecount;
+	const _dywapitch_kernel *k = &_dywapitch_kernels_s16[pitchtracker->_precision];
+	int level;
+	
+	if (n < 4*DYWA_INCREMENTAL_STEP) {
+		// too short for all the levels to line up
+		return dywapitch_computerawpitch_s16(pitchtracker, samples);
+	}
+	if (!inc->valid || inc->precision != pitchtracker->_precision
+	    || advanced <= 0 || advanced >= n || advanced % DYWA_INCREMENTAL_STEP != 0) {
+		// start over with this window; also if none of the previous one is left,
+		// as its last samples would still make turning points at the start
+		for (level = 0; level < DYWA_MAX_FLWT_LEVELS; level++) {
+			_dywapitch_levelstream *ls = &inc->levels[level];
+			ls->count = 0;
+			ls->last[0] = ls->last[1] = 0;
+			ls->firstTurn = ls->endTurn = 0;
+		}
+		inc->sum = 0;
+		inc->valid = 1;
+		inc->precision = pitchtracker->_precision;
+		advanced = n;
+	}
+	_dywapitch_advancestreams(pitchtracker, k, samples, advanced);
+	
+	// the DC and maxAMplitude; the extrema are at the turning points of level 0,
+	// or at the ends
+	const _dywapitch_levelstream *ls = &inc->levels[0];
+	double maxValue = 0.0;
+	double minValue = 0.0;
+	maxValue = max(maxValue, max(max(samples[0], samples[1]), samples[n-1]));
+	minValue = min(minValue, min(min(samples[0], samples[1]), samples[n-1]));
+	long long j;
+	for (j = ls->firstTurn; j < ls->endTurn; j++) {
+		const _dywapitch_turn *turn = &ls->turns[j & ls->turnMask];
+		if (turn->isMax) maxValue = max(maxValue, turn->prevValue);
+		else minValue = min(minValue, turn->prevValue);
+	}
+	double theDC = (double)inc->sum / n;
+	maxValue = maxValue - theDC;
+	minValue = minValue - theDC;
+	double amplitudeMax = (maxValue > -minValue ? maxValue : -minValue);
+	
+	return _dywapitch_computeWaveletPitch(pitchtracker, k, samples, theDC, amplitudeMax, inc);
+}
+
+double dywapitch_computepitch(dywapitchtracker *pitchtracker, const double * samples) {
+	double raw_pitch = dywapitch_computerawpitch(pitchtracker, samples);
+	return _dywapitch_dynamicprocess(pitchtracker, raw_pitch);
+}
+
+double dywapitch_computepitch_s16(dywapitchtracker *pitchtracker, const short * samples) {
+	double raw_pitch = dywapitch_computerawpitch_s16(pitchtracker, samples);
+	return _dywapitch_dynamicprocess(pitchtracker, raw_pitch);
+}
+
+double dywapitch_computepitch_incremental_s16(dywapitchtracker *pitchtracker, const short * samples, int advanced) {
+	double raw_pitch = dywapitch_computerawpitch_incremental_s16(pitchtracker, samples, advanced);
 	return _dywapitch_dynamicprocess(pitchtracker, raw_pitch);
 }
 
+double dywapitch_trustedpitch(dywapitchtracker *pitchtracker) {
+	if (pitchtracker->_prevPitch <= 0 || pitchtracker->_pitchConfidence < DYWA_MAX_CONFIDENCE-2)
+		return 0.0;
+	return pitchtracker->_prevPitch;
+}
+
+double dywapitch_confidence(dywapitchtracker *pitchtracker) {
+	if (pitchtracker->_prevPitch <= 0 || pitchtracker->_pitchConfidence <= 0)
+		return 0.0;
+	return (double)pitchtracker->_pitchConfidence / DYWA_MAX_CONFIDENCE;
+}
+
+int dywapitch_levelsused(dywapitchtracker *pitchtracker) {
+	return pitchtracker->_levelsUsed;
+}
+
+double dywapitch_dynamicprocess(dywapitchtracker *pitchtracker, double rawpitch) {
+	return _dywapitch_dynamicprocess(pitchtracker, rawpitch);
+}
+
 
 
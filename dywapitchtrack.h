@@ -57,8 +57,10 @@
  over time and makes assumptions about human voice capabilities and reallife conditions
  (as documented inside the code).
  
- Note : The algorithm currently assumes a 44100Hz audio sampling rate. If you use a different
- samplerate, you can just multiply the resulting pitch by the ratio between your samplerate and 44100.
+ The sample rate is passed to dywapitch_inittracking. Lower sample rates make the
+ computation cheaper: the window needed for a given minimum frequency is proportionally
+ smaller. The highest detected frequency is 3000Hz, so the samplerate should be well above
+ 6000Hz.
 */
 
 /* Usage
@@ -67,10 +69,10 @@
  // Allocate a 'dywapitchtracker' structure.
  // Start the pitch tracking by calling 'dywapitch_inittracking'.
  dywapitchtracker pitchtracker;
- dywapitch_inittracking(&pitchtracker);
+ dywapitch_inittracking(&pitchtracker, dywapitch_neededsamplecount(minFreq, samplerate), samplerate);
  
  // For each available audio buffer, call 'dywapitch_computepitch'
- double thepitch = dywapitch_computepitch(&pitchtracker, samples, start, count);
+ double thepitch = dywapitch_computepitch(&pitchtracker, samples);
  
 */
 
@@ -81,30 +83,95 @@
 extern "C" {
 #endif
 
+// precision of the wavelet levels, for the 16 bit sample entry points
+typedef enum {
+	DYWAPITCH_DOUBLE = 0,  // same result as the double entry points
+	DYWAPITCH_FLOAT,
+	DYWAPITCH_FIXED        // integer arithmetic only
+} dywapitch_precision;
+
 // structure to hold tracking data
 typedef struct _dywapitchtracker {
 	double _prevPitch;
 	int _pitchConfidence;
 	int _samplecount;
-	int *_distances;
+	double _samplerate;
+	int *_distances;       // distinct distances between extrema, sorted
+	int *_distanceCounts;  // number of occurrences of each distance
 	int *_mins;
 	int *_maxs;
+	double *_minOffsets;  // of the exact position of each extremum, from its index
+	double *_maxOffsets;
+	int *_candidates;  // indices worth looking at in the extremum search
+	void *_levels;     // downsampled signal of each wavelet level
+	dywapitch_precision _precision;
+	struct _dywapitch_incremental *_incremental;  // kept from window to window
+	int _levelsUsed;   // by the last computation
 } dywapitchtracker;
 
 // returns the number of samples needed to compute pitch for fequencies equal and above the given minFreq (in Hz)
 // useful to allocate large enough audio buffer 
-// ex : for frequencies above 130Hz, you need 1024 samples (assuming a 44100 Hz samplerate)
-int dywapitch_neededsamplecount(int minFreq);
+// ex : for frequencies above 130Hz, you need 1024 samples at a 44100 Hz samplerate
+int dywapitch_neededsamplecount(int minFreq, int samplerate);
+
+// call before computing any pitch, passing an allocated dywapitchtracker structure,
+// the number of samples per call and the samplerate of the audio in Hz
+void dywapitch_inittracking(dywapitchtracker *pitchtracker, int samplecount, int samplerate);
+
+// frees the buffers allocated in dywapitch_inittracking
+void dywapitch_delete(dywapitchtracker *pitchtracker);
 
-// call before computing any pitch, passing an allocated dywapitchtracker structure
-void dywapitch_inittracking(dywapitchtracker *pitchtracker, int samplecount);
+// instead of dywapitch_inittracking, for a tracker that is only fed raw pitches with
+// dywapitch_dynamicprocess and asked for the pitch it tracks : no buffers are allocated,
+// so it can't compute pitches itself. dywapitch_delete does nothing on it.
+void dywapitch_initdynamic(dywapitchtracker *pitchtracker);
 
 // computes the pitch. Pass the inited dywapitchtracker structure
 // samples : a pointer to the sample buffer
 // startsample : the index of teh first sample to use in teh sample buffer
 // samplecount : the number of samples to use to compte the pitch
 // return 0.0 if no pitch was found (sound too low, noise, etc..)
-double dywapitch_computepitch(dywapitchtracker *pitchtracker, double * samples);
+// the samples are not modified, so the buffer can be re-used for the next call
+double dywapitch_computepitch(dywapitchtracker *pitchtracker, const double * samples);
+
+// the same, for signed 16 bit samples, which are analyzed without converting them first.
+// The result does not depend on the scale of the samples, so it is the same as for
+// samples/32768. in doubles.
+double dywapitch_computepitch_s16(dywapitchtracker *pitchtracker, const short * samples);
+
+// the same, for a window that slides over a stream : "samples" is the window of the
+// previous call to this function, moved forward by "advanced" samples. Only the newest
+// "advanced" samples are analyzed, the work done on the others is kept in the tracker.
+// Same result as dywapitch_computepitch_s16, but much cheaper if the window moved by
+// a small part of it. The work can only be kept if "advanced" is a multiple of 32;
+// pass 0 if the window is not related to the one of the previous call.
+double dywapitch_computepitch_incremental_s16(dywapitchtracker *pitchtracker, const short * samples, int advanced);
+
+// sets the precision used by the 16 bit entry points (default DYWAPITCH_DOUBLE).
+// float and fixed trade a little accuracy for speed.
+void dywapitch_setprecision(dywapitchtracker *pitchtracker, dywapitch_precision precision);
+
+// The two steps of dywapitch_computepitch, for callers that want to run
+// the expensive part on several threads.
+// dywapitch_computerawpitch only uses the scratch buffers of the tracker,
+// not its tracking state, so it can run on a separate tracker per thread.
+// dywapitch_dynamicprocess then has to be fed the raw pitches in order.
+double dywapitch_computerawpitch(dywapitchtracker *pitchtracker, const double * samples);
+double dywapitch_computerawpitch_s16(dywapitchtracker *pitchtracker, const short * samples);
+double dywapitch_computerawpitch_incremental_s16(dywapitchtracker *pitchtracker, const short * samples, int advanced);
+double dywapitch_dynamicprocess(dywapitchtracker *pitchtracker, double rawpitch);
+
+// the pitch the dynamic tracking currently trusts, as used to correct octave errors.
+// 0.0 if none
+double dywapitch_trustedpitch(dywapitchtracker *pitchtracker);
+
+// how sure the dynamic tracking is of its current pitch, from 0.0 (not at all)
+// to 1.0 (the same pitch was found a few times in a row)
+double dywapitch_confidence(dywapitchtracker *pitchtracker);
+
+// the number of wavelet levels the last pitch computation went through, 1 to 6.
+// Lower pitches and unclear signals need more
+int dywapitch_levelsused(dywapitchtracker *pitchtracker);
 
 #ifdef __cplusplus
 } // extern "C"
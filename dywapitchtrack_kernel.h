@@ -0,0 +1,194 @@
+/* dywapitchtrack_kernel.h
+
+ Sample kernels of the Dynamic Wavelet Algorithm Pitch Tracking library,
+ for one pair of sample types. Only to be included by dywapitchtrack.c,
+ once per instantiation, with these defined :
+   DYWA_ELEM   : type of the samples read
+   DYWA_CT     : type in which the kernels compute
+   DYWA_LEVEL  : type of the downsampled level written
+   DYWA_SUFFIX : appended to the function names
+   DYWA_FIXED  : (optional) integer levels, holding sums instead of averages
+   DYWA_TURNS  : (optional) also generate the extremum search on turning points,
+                 for the downsampled levels
+ They are all undefined at the end of this file.
+
+ */
+
+#define DYWA_PASTE2(a, b) a##_##b
+#define DYWA_PASTE(a, b) DYWA_PASTE2(a, b)
+#define DYWA_FN(name) DYWA_PASTE(name, DYWA_SUFFIX)
+
+// the extremum search, same as _dywapitch_extrema_d
+static void DYWA_FN(_dywapitch_extrema)(const void *samples, int curSamNb, double theDC, double ampltitudeThreshold, int delta,
+                                        struct _dywapitchtracker *t, int *nbMinsOut, int *nbMaxsOut) {
+	const DYWA_ELEM *sam = (const DYWA_ELEM *)samples;
+#ifdef DYWA_FIXED
+	const DYWA_CT dc = (DYWA_CT)lrint(theDC);
+	const DYWA_CT threshold = (DYWA_CT)ceil(ampltitudeThreshold);
+#else
+	const DYWA_CT dc = (DYWA_CT)theDC;
+	const DYWA_CT threshold = (DYWA_CT)ampltitudeThreshold;
+#endif
+	int i, nbMins = 0, nbMaxs = 0;
+	DYWA_CT si, si1, dv, previousDV = 0;
+#define DYWA_VERTEX _dywapitch_vertex((double)sam[i-2], (double)sam[i-1], (double)sam[i])
+	int havePreviousDV = 0;  // the -1000 of the double code is a valid derivative here
+	int lastMinIndex = -1000000;
+	int lastmaxIndex = -1000000;
+	int findMax = 0;
+	int findMin = 0;
+	for (i = 2; i < curSamNb; i++) {
+		si = (DYWA_CT)sam[i] - dc;
+		si1 = (DYWA_CT)sam[i-1] - dc;
+
+		if (si1 <= 0 && si > 0) findMax = 1;
+		if (si1 >= 0 && si < 0) findMin = 1;
+
+		// min or max ?
+		dv = si - si1;
+
+		if (havePreviousDV) {
+			const DYWA_CT absSi = (si < 0 ? -si : si);
+
+			if (findMin && previousDV < 0 && dv >= 0) {
+				// minimum
+				if (absSi >= threshold && i > lastMinIndex + delta) {
+					t->_minOffsets[nbMins] = DYWA_VERTEX;
+					t->_mins[nbMins++] = i;
+					lastMinIndex = i;
+					findMin = 0;
+				}
+			}
+
+			if (findMax && previousDV > 0 && dv <= 0) {
+				// maximum
+				if (absSi >= threshold && i > lastmaxIndex + delta) {
+					t->_maxOffsets[nbMaxs] = DYWA_VERTEX;
+					t->_maxs[nbMaxs++] = i;
+					lastmaxIndex = i;
+					findMax = 0;
+				}
+			}
+		}
+
+		previousDV = dv;
+		havePreviousDV = 1;
+	}
+#undef DYWA_VERTEX
+	*nbMinsOut = nbMins;
+	*nbMaxsOut = nbMaxs;
+}
+
+// the next level, of n/2 samples
+static void DYWA_FN(_dywapitch_downsample)(const void *src, int n, void *dst) {
+	const DYWA_ELEM *sam = (const DYWA_ELEM *)src;
+	DYWA_LEVEL *nextLevel = (DYWA_LEVEL *)dst;
+	int i;
+	for (i = 0; i < n/2; i++) {
+#ifdef DYWA_FIXED
+		nextLevel[i] = (DYWA_LEVEL)sam[2*i] + (DYWA_LEVEL)sam[2*i + 1];
+#else
+		nextLevel[i] = ((DYWA_CT)sam[2*i] + (DYWA_CT)sam[2*i + 1])/2;
+#endif
+	}
+}
+
+// appends n new samples to the stream of a level : stores them, finds the
+// turning points, and writes the n/2 samples of the next level to dst (if not NULL)
+static void DYWA_FN(_dywapitch_advance)(const void *src, int n, _dywapitch_levelstream *ls, void *dst) {
+	const DYWA_ELEM *sam = (const DYWA_ELEM *)src;
+	double x, x1 = ls->last[1], x2 = ls->last[0];
+	long long pos = ls->count;
+	int i;
+	for (i = 0; i < n; i++, pos++) {
+		x = sam[i];
+		ls->values[pos & ls->valueMask] = x;
+		// the sign of the derivative does not depend on the DC, so compare
+		// the samples directly
+		if (pos >= 2 && ((x1 < x2 && x >= x1) || (x1 > x2 && x <= x1))) {
+			_dywapitch_turn *turn = &ls->turns[ls->endTurn++ & ls->turnMask];
+			turn->pos = pos;
+			turn->isMax = (x1 > x2);
+			turn->value = x;
+			turn->prevValue = x1;
+			turn->prevPrevValue = x2;
+		}
+		x2 = x1;
+		x1 = x;
+	}
+	ls->last[0] = x2;
+	ls->last[1] = x1;
+	ls->count = pos;
+	if (dst != NULL) {
+		DYWA_FN(_dywapitch_downsample)(src, n, dst);
+	}
+}
+
+#ifdef DYWA_TURNS
+// the extremum search of _dywapitch_extrema on the window of curSamNb samples
+// that ends with the newest sample of the stream. Between two turning points the
+// signal is monotonic, so whether it crosses the DC in between only depends on
+// the samples at the turning points; the samples in between need not be visited.
+static void DYWA_FN(_dywapitch_turns)(const _dywapitch_levelstream *ls, int curSamNb, double theDC, double ampltitudeThreshold, int delta,
+                                      struct _dywapitchtracker *t, int *nbMinsOut, int *nbMaxsOut) {
+#ifdef DYWA_FIXED
+	const DYWA_CT dc = (DYWA_CT)lrint(theDC);
+	const DYWA_CT threshold = (DYWA_CT)ceil(ampltitudeThreshold);
+#else
+	const DYWA_CT dc = (DYWA_CT)theDC;
+	const DYWA_CT threshold = (DYWA_CT)ampltitudeThreshold;
+#endif
+	const long long offset = ls->count - curSamNb;
+	int i, nbMins = 0, nbMaxs = 0;
+	int lastMinIndex = -1000000;
+	int lastmaxIndex = -1000000;
+	int findMax = 0;
+	int findMin = 0;
+	// the zero crossings are looked for from the sample at index 1 on
+	DYWA_CT from = (DYWA_CT)ls->values[(offset + 1) & ls->valueMask];
+	long long k;
+	for (k = ls->firstTurn; k < ls->endTurn; k++) {
+		const _dywapitch_turn *turn = &ls->turns[k & ls->turnMask];
+		const DYWA_CT x = (DYWA_CT)turn->value;
+		const DYWA_CT x1 = (DYWA_CT)turn->prevValue;
+		i = turn->pos - offset;
+
+		// crossings on the way from the previous turning point up to i-1, and at i
+		if ((from <= dc && x1 > dc) || (x1 <= dc && x > dc)) findMax = 1;
+		if ((from >= dc && x1 < dc) || (x1 >= dc && x < dc)) findMin = 1;
+		from = x;
+
+		const DYWA_CT si = x - dc;
+		const DYWA_CT absSi = (si < 0 ? -si : si);
+		if (!turn->isMax) {
+			// minimum
+			if (findMin && absSi >= threshold && i > lastMinIndex + delta) {
+				t->_minOffsets[nbMins] = _dywapitch_vertex(turn->prevPrevValue, turn->prevValue, turn->value);
+				t->_mins[nbMins++] = i;
+				lastMinIndex = i;
+				findMin = 0;
+			}
+		} else {
+			// maximum
+			if (findMax && absSi >= threshold && i > lastmaxIndex + delta) {
+				t->_maxOffsets[nbMaxs] = _dywapitch_vertex(turn->prevPrevValue, turn->prevValue, turn->value);
+				t->_maxs[nbMaxs++] = i;
+				lastmaxIndex = i;
+				findMax = 0;
+			}
+		}
+	}
+	*nbMinsOut = nbMins;
+	*nbMaxsOut = nbMaxs;
+}
+#endif
+
+#undef DYWA_FN
+#undef DYWA_PASTE
+#undef DYWA_PASTE2
+#undef DYWA_ELEM
+#undef DYWA_CT
+#undef DYWA_LEVEL
+#undef DYWA_SUFFIX
+#undef DYWA_FIXED
+#undef DYWA_TURNS
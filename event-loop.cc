@@ -0,0 +1,85 @@
+#include "event-loop.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+EventLoop::~EventLoop() {
+  for (const Source &source : sources_) {
+    if (source.is_timer) close(source.fd);
+  }
+}
+
+void EventLoop::AddFd(int fd, const Handler &handler) {
+  sources_.push_back({fd, handler, false});
+}
+
+void EventLoop::RemoveFd(int fd) {
+  for (size_t i = 0; i < sources_.size(); ++i) {
+    if (sources_[i].fd == fd) {
+      sources_.erase(sources_.begin() + i);
+      return;
+    }
+  }
+}
+
+int EventLoop::CreateTimer(const Handler &handler) {
+  const int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+  if (fd < 0)
+    return -1;
+  sources_.push_back({fd, handler, true});
+  return fd;
+}
+
+void EventLoop::StartTimer(int id, double seconds) {
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  if (seconds > 0) {
+    const int64_t nanos = seconds * 1e9;
+    spec.it_value.tv_sec = nanos / 1000000000;
+    spec.it_value.tv_nsec = nanos % 1000000000;
+    // All zero would stop it.
+    if (spec.it_value.tv_sec == 0 && spec.it_value.tv_nsec == 0)
+      spec.it_value.tv_nsec = 1;
+  }
+  timerfd_settime(id, 0, &spec, NULL);
+}
+
+bool EventLoop::Run() {
+  quit_ = false;
+  while (!quit_) {
+    pollfds_.resize(sources_.size());
+    for (size_t i = 0; i < sources_.size(); ++i) {
+      pollfds_[i].fd = sources_[i].fd;
+      pollfds_[i].events = POLLIN;
+      pollfds_[i].revents = 0;
+    }
+    if (poll(pollfds_.data(), pollfds_.size(), -1) < 0) {
+      if (errno == EINTR)   // E.g. a terminal resize.
+        continue;
+      return false;
+    }
+    // Handlers may add and remove sources, so go by file descriptor.
+    ready_.clear();
+    for (const struct pollfd &p : pollfds_) {
+      if (p.revents != 0) ready_.push_back(p.fd);
+    }
+    for (int fd : ready_) {
+      for (size_t i = 0; i < sources_.size() && !quit_; ++i) {
+        if (sources_[i].fd != fd)
+          continue;
+        if (sources_[i].is_timer) {
+          uint64_t expirations;
+          if (read(fd, &expirations, sizeof(expirations)) < 0)
+            break;   // Restarted in the meantime.
+        }
+        const Handler handler = sources_[i].handler;
+        handler();
+        break;
+      }
+    }
+  }
+  return true;
+}
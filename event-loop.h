@@ -0,0 +1,55 @@
+#ifndef PITCH_HERO_EVENT_LOOP_H
+#define PITCH_HERO_EVENT_LOOP_H
+
+#include <poll.h>
+
+#include <functional>
+#include <vector>
+
+// Waits for any number of file descriptors and timers in one poll(), and
+// calls the handler of each one that is ready. Nothing runs in between,
+// so there is no polling: input is handled as soon as it arrives.
+//
+// Timers are timerfds, so they are just more file descriptors. Other
+// threads can wake the loop by writing to an eventfd that was added; the
+// loop itself is only to be used from the thread running it.
+class EventLoop {
+public:
+  typedef std::function<void()> Handler;
+
+  EventLoop() : quit_(false) {}
+  ~EventLoop();   // Closes the timers; added file descriptors stay open.
+
+  // Call "handler" whenever "fd" is readable, or closed at the other end,
+  // until RemoveFd(). The handler needs to read what is there, or it is
+  // called again right away.
+  void AddFd(int fd, const Handler &handler);
+  void RemoveFd(int fd);
+
+  // A timer calling "handler" when it expires. Returns its id for
+  // StartTimer(), or -1 on failure with errno set.
+  int CreateTimer(const Handler &handler);
+
+  // Expire timer "id" once in "seconds" from now, replacing an earlier
+  // start; 0 or less stops it.
+  void StartTimer(int id, double seconds);
+
+  // Dispatch until Quit() is called by a handler. Returns false, with
+  // errno set, if waiting failed.
+  bool Run();
+  void Quit() { quit_ = true; }
+
+private:
+  struct Source {
+    int fd;
+    Handler handler;
+    bool is_timer;
+  };
+
+  std::vector<Source> sources_;
+  std::vector<struct pollfd> pollfds_;   // Reused for each wait.
+  std::vector<int> ready_;
+  bool quit_;
+};
+
+#endif  // PITCH_HERO_EVENT_LOOP_H
@@ -0,0 +1,47 @@
+#include "fft.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+Fft::Fft(int size) : size_(size), twiddle_(size / 2), swap_with_(size) {
+  for (int k = 0; k < size / 2; ++k)
+    twiddle_[k] = std::polar(1.0, -2 * M_PI * k / size);
+  int bits = 0;
+  while ((1 << bits) < size) ++bits;
+  for (int i = 0; i < size; ++i) {
+    int reversed = 0;
+    for (int b = 0; b < bits; ++b) {
+      if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+    }
+    swap_with_[i] = reversed;
+  }
+}
+
+int Fft::SizeFor(int n) {
+  int size = 1;
+  while (size < n) size *= 2;
+  return size;
+}
+
+void Fft::Transform(Complex *data, bool inverse) const {
+  for (int i = 0; i < size_; ++i) {
+    if (swap_with_[i] > i) std::swap(data[i], data[swap_with_[i]]);
+  }
+  for (int half = 1; half < size_; half *= 2) {
+    const int stride = size_ / (2 * half);
+    for (int start = 0; start < size_; start += 2 * half) {
+      Complex *a = data + start;
+      Complex *b = a + half;
+      for (int k = 0; k < half; ++k) {
+        const Complex &w = twiddle_[k * stride];
+        const double w_imag = inverse ? -w.imag() : w.imag();
+        // b[k] * w spelled out; the operator checks for infinities.
+        const Complex t(b[k].real() * w.real() - b[k].imag() * w_imag,
+                        b[k].real() * w_imag + b[k].imag() * w.real());
+        b[k] = a[k] - t;
+        a[k] += t;
+      }
+    }
+  }
+}
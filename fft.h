@@ -0,0 +1,35 @@
+#ifndef PITCH_HERO_FFT_H
+#define PITCH_HERO_FFT_H
+
+#include <complex>
+#include <vector>
+
+// In-place radix-2 fast Fourier transform of a fixed power of two size.
+// The twiddle factors and the bit reversal permutation are computed once,
+// so a transform does not allocate.
+class Fft {
+public:
+  typedef std::complex<double> Complex;
+
+  // "size" needs to be a power of two.
+  explicit Fft(int size);
+
+  int size() const { return size_; }
+
+  // Transform the size() values in "data". The inverse is not scaled,
+  // so Inverse(Forward(x)) is size() * x.
+  void Forward(Complex *data) const { Transform(data, false); }
+  void Inverse(Complex *data) const { Transform(data, true); }
+
+  // Smallest power of two that is at least "n".
+  static int SizeFor(int n);
+
+private:
+  void Transform(Complex *data, bool inverse) const;
+
+  const int size_;
+  std::vector<Complex> twiddle_;   // e^(-2 pi i k / size) for k < size / 2.
+  std::vector<int> swap_with_;     // Bit reversed index, if larger.
+};
+
+#endif  // PITCH_HERO_FFT_H
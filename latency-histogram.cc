@@ -0,0 +1,75 @@
+#include "latency-histogram.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <algorithm>
+
+int64_t MonotonicNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void LatencyHistogram::Record(int64_t nanos) {
+  int bucket = 0;
+  if (nanos > 0) bucket = 64 - __builtin_clzll(nanos);
+  if (bucket >= kBuckets) bucket = kBuckets - 1;
+  buckets_[bucket].fetch_add(1, std::memory_order_relaxed);
+  int64_t seen = max_.load(std::memory_order_relaxed);
+  while (nanos > seen
+         && !max_.compare_exchange_weak(seen, nanos,
+                                        std::memory_order_relaxed)) {
+  }
+}
+
+uint64_t LatencyHistogram::count() const {
+  uint64_t sum = 0;
+  for (int b = 0; b < kBuckets; ++b)
+    sum += buckets_[b].load(std::memory_order_relaxed);
+  return sum;
+}
+
+int64_t LatencyHistogram::Percentile(double percentile) const {
+  uint32_t counts[kBuckets];
+  uint64_t total = 0;
+  for (int b = 0; b < kBuckets; ++b) {
+    counts[b] = buckets_[b].load(std::memory_order_relaxed);
+    total += counts[b];
+  }
+  if (total == 0)
+    return 0;
+  const double wanted = total * percentile / 100;
+  uint64_t sum = 0;
+  for (int b = 0; b < kBuckets; ++b) {
+    sum += counts[b];
+    if (sum >= wanted && counts[b] > 0)
+      return std::min(1LL << b, (long long) max());
+  }
+  return max();
+}
+
+static void FormatNanos(int64_t nanos, char *buffer, size_t size) {
+  if (nanos < 10000)
+    snprintf(buffer, size, "%lldns", (long long) nanos);
+  else if (nanos < 10000000)
+    snprintf(buffer, size, "%lldus", (long long) nanos / 1000);
+  else
+    snprintf(buffer, size, "%lldms", (long long) nanos / 1000000);
+}
+
+void LatencyHistogram::Summary(char *buffer, size_t size) const {
+  char p50[24], p90[24], p99[24], max_val[24];
+  FormatNanos(Percentile(50), p50, sizeof(p50));
+  FormatNanos(Percentile(90), p90, sizeof(p90));
+  FormatNanos(Percentile(99), p99, sizeof(p99));
+  FormatNanos(max(), max_val, sizeof(max_val));
+  snprintf(buffer, size, "%8llu  p50<=%-7s p90<=%-7s p99<=%-7s max %s",
+           (unsigned long long) count(), p50, p90, p99, max_val);
+}
+
+void LatencyHistogram::Reset() {
+  for (int b = 0; b < kBuckets; ++b)
+    buckets_[b].store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
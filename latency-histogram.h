@@ -0,0 +1,51 @@
+#ifndef PITCH_HERO_LATENCY_HISTOGRAM_H
+#define PITCH_HERO_LATENCY_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <atomic>
+
+// Now on the monotonic clock, in nanoseconds. Only good for durations.
+int64_t MonotonicNanos();
+
+// Histogram of durations in buckets of powers of two nanoseconds.
+//
+// Cheap enough to be always on: recording is a relaxed atomic increment
+// (plus a compare-and-swap on a new maximum), so any number of threads can
+// record while another one reads. Readers see each bucket consistent on
+// its own, which is plenty for a display.
+class LatencyHistogram {
+public:
+  LatencyHistogram() { Reset(); }
+
+  void Record(int64_t nanos);
+
+  // Record the time since "start" and return now, to time the next stage.
+  int64_t RecordSince(int64_t start) {
+    const int64_t now = MonotonicNanos();
+    Record(now - start);
+    return now;
+  }
+
+  uint64_t count() const;
+  int64_t max() const { return max_.load(std::memory_order_relaxed); }
+
+  // Upper bound of the "percentile" (0..100) duration: that of its bucket,
+  // or the maximum if lower. 0 if nothing was recorded.
+  int64_t Percentile(double percentile) const;
+
+  // "count, p50, p90, p99 and max" in readable units, into "buffer".
+  void Summary(char *buffer, size_t size) const;
+
+  void Reset();
+
+private:
+  // Bucket b holds durations in [2^(b-1), 2^b) ns; up to minutes.
+  static const int kBuckets = 40;
+
+  std::atomic<uint32_t> buckets_[kBuckets];
+  std::atomic<int64_t> max_;
+};
+
+#endif  // PITCH_HERO_LATENCY_HISTOGRAM_H
@@ -2,28 +2,60 @@
 // TODO: Get rid of global variables and stuff.
 #include <ncurses.h>
 
-#include <alsa/asoundlib.h>
 #include <math.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <sys/time.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
 
 #include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
 #include <vector>
 
-#include "dywapitchtrack.h"
+#include "alsa-capture.h"
+#include "audio-file.h"
+#include "event-loop.h"
+#include "latency-histogram.h"
+#include "note-util.h"
+#include "offline-analysis.h"
+#include "pitch-analyzer.h"
+#include "pitch-detector.h"
+#include "spsc-queue.h"
+#include "stat-counter.h"
+#include "stats-store.h"
 
 static const int kSeizureMode = false;   // :) show when we're off
 static const int kMaxNotesAboveC = 35;
 
-static const double kPitchA = 440.0; // Hz.
-
 static const int kPitchDisplay = 1; // size of the flat/sharp bars top/bottom.
 static int kStringSpace = 16;   // horizontal space between strings
 static int kHalftoneSpace = 4;  // vertical space between halftones
 
 int cent_threshold = 20;
-bool paused = false;
+// The thresholds the keys step through: single cents up to 10 for the
+// tight thresholds of advanced players, then steps of 5.
+static const int kMaxCentThreshold = 45;
+static int next_cent_threshold(int threshold) {
+  if (threshold >= kMaxCentThreshold) return threshold;
+  return threshold + (threshold < 10 ? 1 : 5);
+}
+static int previous_cent_threshold(int threshold) {
+  if (threshold <= 1) return threshold;
+  return threshold - (threshold <= 10 ? 1 : 5);
+}
+std::atomic<bool> paused(false);   // read by the analysis thread.
 
 enum {
   COL_NEUTRAL,
@@ -34,15 +66,7 @@ enum {
   COL_VU_METER,
 };
 
-enum KeyDisplay {
-  DISPLAY_FLAT,
-  DISPLAY_SHARP,
-};
 static KeyDisplay s_key_display = DISPLAY_SHARP;
-const char *note_name[2][12] = {
-  { "A", "Bb", "B", "C", "Db", "D", "Eb", "E", "F", "Gb", "G", "Ab" },
-  { "A", "A#", "B", "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#" },
-};
 
 class StringBoard {
 public:
@@ -64,25 +88,61 @@ public:
     }
   }
 
+  // The character the board has at screen position x, y; ' ' if none.
+  char CellAt(int x, int y) const {
+    const int dx = x - origin_x_;
+    const int dy = y - origin_y_;
+    if (dx < 0 || dy < 0)
+      return ' ';
+    if (dx % kStringSpace == 0 && dx / kStringSpace < kStrings
+        && dy < 7 * kHalftoneSpace)
+      return dy % kHalftoneSpace == 0 ? '+' : '|';
+    if (dy == 0 && dx < (kStrings - 1) * kStringSpace)
+      return '-';
+    return ' ';
+  }
+
+  // Redraw the plain board over "width" cells from x, y.
+  void Restore(int x, int y, int width) {
+    wcolor_set(display_, COL_NEUTRAL, NULL);
+    for (int i = 0; i < width; ++i) {
+      mvwaddch(display_, y, x + i, CellAt(x + i, y));
+    }
+  }
+
+  // Area covered by PrintNote(): the name, and the cent bar above or below.
+  static const int kNoteWidth = 13;
+  int NoteX(int str) const { return origin_x_ + kStringSpace * str - 6; }
+  int NoteY(int position) const { return origin_y_ + kHalftoneSpace * position; }
+
+  // Length of the bar PrintNote() shows for "cent"; negative if flat.
+  static int CentBar(float cent) {
+    if (cent < -5) return -(int) (kNoteWidth / 50.0 * -cent);
+    if (cent > 5) return kNoteWidth / 50.0 * cent;
+    return 0;
+  }
+
+  // The note name, with a bar of CentBar() cells above if flat, below if
+  // sharp.
   void PrintNote(const char *name, int str, int position, bool in_tune,
-                 float cent) {
+                 int cent_bar) {
     wcolor_set(display_, in_tune ? COL_OK : COL_WARN, NULL);
-    const int pitch_screen_pos_y = origin_y_ + kHalftoneSpace * position;
-    const int string_screen_pos_x = origin_x_ + kStringSpace * str - 6;
+    const int pitch_screen_pos_y = NoteY(position);
+    const int string_screen_pos_x = NoteX(str);
     
     mvwprintw(display_, pitch_screen_pos_y, string_screen_pos_x,
               "      %-7s", name);
-    const int bargraph_width = 13;
-    if (cent < -5) {
-      int bar_len = bargraph_width / 50.0 * -cent;
+    const int bar_len = cent_bar;
+    if (bar_len < 0) {
       mvwchgat(display_, pitch_screen_pos_y - 1,
-               string_screen_pos_x + bargraph_width - bar_len,
-               bar_len, 0, COL_WARN, NULL);
+               string_screen_pos_x + kNoteWidth + bar_len,
+               -bar_len, 0, COL_WARN, NULL);
     }
-    else if (cent > 5) {
+    else if (bar_len > 0) {
       mvwchgat(display_, pitch_screen_pos_y + 1, string_screen_pos_x,
-               bargraph_width / 50.0 * cent, 0, COL_WARN, NULL);
+               bar_len, 0, COL_WARN, NULL);
     }
+    wcolor_set(display_, COL_NEUTRAL, NULL);
   }
 
   void PrintBargraph(const char *note_name, int str, int position,
@@ -130,65 +190,231 @@ private:
   const int origin_y_;
 };
 
-class StatCounter {
-public:
-  struct Counter {
-    Counter() : flat(0), ok(0), sharp(0) {}
-    int flat;
-    int ok;
-    int sharp;
-  };
-  StatCounter(int max_note) : note_count_(max_note),
-                              histogram_(new Histogram [max_note]) {
-    Reset();
-  }
-  ~StatCounter() { delete [] histogram_; }
+bool kShowCount = false;   // useful for debugging.
+
+// A detected pitch, passed from the analysis thread to the UI.
+struct AnalysisResult {
+  double freq;    // 0.0 if nothing detected or not analyzed.
+  int max_val;    // Peak value of the newest hop.
+  int window;     // Samples analyzed; 0 if not analyzed.
+  double latency; // Seconds from capture of the newest hop to the result.
+  double confidence;  // Of the tracking in freq, 0.0 to 1.0.
+};
 
+// All results of a player between two frames on screen, in the form they
+// are shown: the newest pitch, and how much the cent varied on its note.
+struct FrameSummary {
+  FrameSummary() { Reset(); }
   void Reset() {
-    memset(histogram_, 0, note_count_ * sizeof(Histogram));
-  }
-  void Count(int note, int cent) {
-    if (note < 0 || note >= note_count_) return;
-    int index = (cent + 50) / 5;
-    if (index > 19) index = 19;
-    ++histogram_[note].histogram[index];
+    count = 0;
+    freq = 0.0;
+    max_val = 0;
+    confidence = 0.0;
+    note = -1;
+    min_cent = max_cent = 0.0;
   }
-
-  int size() const { return note_count_; }
-  Counter get_stat_for(int note, int threshold) const {
-    Counter result;
-    if (note < 0 || note >= note_count_) return result;
-    const Histogram &h = histogram_[note];
-    for (int i = 0; i < 10 - threshold / 5; ++i) {
-      result.flat += h.histogram[i];
-    }
-    for (int i = 10 - threshold / 5; i < 10 + threshold / 5; ++i) {
-      result.ok += h.histogram[i];
+  void Add(const AnalysisResult &r) {
+    ++count;
+    freq = r.freq;
+    max_val = r.max_val;
+    confidence = r.confidence;
+    if (r.freq < 64 || r.freq > 650) {
+      note = -1;
+      return;
     }
-    for (int i = 10 + threshold / 5; i < 20; ++i) {
-      result.sharp += h.histogram[i];
+    const NoteInfo info = FrequencyToNote(r.freq);
+    if (info.scale_above_C != note) {
+      note = info.scale_above_C;
+      min_cent = max_cent = info.cent;
     }
-    return result;
+    min_cent = std::min(min_cent, info.cent);
+    max_cent = std::max(max_cent, info.cent);
   }
 
-private:
-  struct Histogram {
-    int histogram[20];  // 0..9 (flat -49..0) 10..19 (sharp 0..49)
-  };
-  const int note_count_;
-  Histogram *const histogram_;
+  int count;          // Results since the last frame.
+  double freq;        // The newest of them.
+  int max_val;
+  double confidence;
+  int note;           // Of freq, while in our range; otherwise -1.
+  double min_cent;    // Range of the newest results on that note.
+  double max_cent;
 };
-static StatCounter sStatCounter(kMaxNotesAboveC);
 
-bool kShowCount = false;   // useful for debugging.
+// How long it takes from a sound to its pitch on screen. Half the analyzed
+// window is how far back its center lies; add the capture to result time.
+struct LatencyStats {
+  LatencyStats() : count(0), window_sum(0), latency_sum(0), latency_max(0),
+                   last_latency(0), last_window(0) {}
+  void Count(const AnalysisResult &r, int sample_rate) {
+    const double latency = 0.5 * r.window / sample_rate + r.latency;
+    ++count;
+    window_sum += r.window;
+    latency_sum += latency;
+    if (latency > latency_max) latency_max = latency;
+    last_latency = latency;
+    last_window = r.window;
+  }
+
+  int count;
+  double window_sum;
+  double latency_sum;
+  double latency_max;
+  double last_latency;
+  int last_window;
+};
+
+// One instrument, on one channel of the capture device. Each player has
+// its own analysis thread and statistics.
+struct Player {
+  Player(PitchAnalyzer *a, double recent_seconds)
+    : analyzer(a), dropped_hops(0), dropped_results(0),
+      stats(kMaxNotesAboveC), recent(kMaxNotesAboveC, recent_seconds),
+      session_start(time(NULL)), last_minloud_time(-1) {
+    sem_init(&samples_ready, 0, 0);
+  }
+  ~Player() {
+    sem_destroy(&samples_ready);
+    delete analyzer;
+  }
+
+  PitchAnalyzer *const analyzer;
+  SPSCQueue<AnalysisResult, 64> results;
+  sem_t samples_ready;                   // Posted for each captured hop.
+  std::atomic<int> dropped_hops;         // Analysis too slow.
+  std::atomic<int> dropped_results;      // UI too slow.
+
+  // Only used by the UI thread.
+  StatCounter stats;
+  RecentStatCounter recent;
+  time_t session_start;                  // Since stats were last reset.
+  LatencyStats latency;
+  double last_minloud_time;
+};
+
+// Where the time goes between audio arriving and a note on screen.
+enum Stage {
+  STAGE_CAPTURE_WAIT,   // Waiting for the device to have a hop.
+  STAGE_CONVERT,        // Copying the samples to the analysis.
+  STAGE_DETECTOR,       // Pitch detection, or confirming it.
+  STAGE_DYNAMIC,        // Dynamic tracking on top of it.
+  STAGE_RENDER,         // Drawing a result.
+  STAGE_COUNT
+};
+static const char *const kStageName[STAGE_COUNT] = {
+  "capture wait", "conversion", "detector", "dynamic", "ui render",
+};
+// Wavelet levels a pitch computation can go through.
+static const int kMaxWaveletLevels = 6;
+
+// Capture, analysis and UI each run in their own thread, so that a slow
+// terminal can't make us lose audio. They are connected by lock-free
+// queues; semaphores wake up the analysis, an eventfd the UI, which waits
+// for it together with the keyboard.
+// The capture thread distributes the channels to the players, which are
+// analyzed in parallel.
+struct LivePipeline {
+  explicit LivePipeline(AlsaCapture *c)
+    : capture(c), results_ready(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      do_exit(false), capture_failed(false), realtime(false) {
+    for (std::atomic<uint32_t> &count : levels_used) count = 0;
+    without_levels = 0;
+  }
+  ~LivePipeline() {
+    for (Player *p : players) delete p;
+    close(results_ready);
+  }
+
+  // Wake up the UI.
+  void PostResults() { eventfd_write(results_ready, 1); }
+
+  int dropped_hops() const {
+    int sum = 0;
+    for (const Player *p : players) sum += p->dropped_hops;
+    return sum;
+  }
+  int dropped_results() const {
+    int sum = 0;
+    for (const Player *p : players) sum += p->dropped_results;
+    return sum;
+  }
+
+  AlsaCapture *const capture;
+  std::vector<Player*> players;   // One per channel.
+  const int results_ready;   // eventfd, posted for each analysis result.
+
+  std::atomic<bool> do_exit;
+  std::atomic<bool> capture_failed;
+  std::atomic<bool> realtime;            // Capture has realtime priority.
+
+  // Always on; recorded by all threads, shown with 'i' and on exit.
+  LatencyHistogram stage_time[STAGE_COUNT];
+  std::atomic<uint32_t> levels_used[kMaxWaveletLevels + 1];
+  std::atomic<uint32_t> without_levels;  // Runs of detectors without levels.
+};
+static const LivePipeline *s_live = NULL;   // Only for status display.
+static int s_player = 0;   // The player shown.
+
+static bool s_show_timing = false;   // The hidden panel, key 'i'.
+static bool s_show_recent = false;   // Statistics of the last minutes only.
+static const int kDefaultRecentSeconds = 300;
+
+// Default rate the terminal is updated at most; results in between are
+// counted and summarized in the next frame.
+static const int kDefaultFramesPerSecond = 30;
 
 static double GetTime() {
-  struct timeval tv;
-  gettimeofday(&tv, NULL);
-  return tv.tv_sec + tv.tv_usec / 1e6;
+  return MonotonicNanos() / 1e9;
+}
+
+// The lines at the end of the menu that change while playing, each ending
+// in a newline.
+static std::string menu_status() {
+  std::string result;
+  if (!s_live)
+    return result;
+  char line[80];
+  const LatencyStats &l = s_live->players[s_player]->latency;
+  if (l.count > 0) {
+    snprintf(line, sizeof(line), " latency %3.0fms (%d samples)\n",
+             1000 * l.last_latency, l.last_window);
+    result += line;
+  }
+  snprintf(line, sizeof(line), " xrun %d drop %d/%d%s\n",
+           s_live->capture->xruns(), s_live->dropped_hops(),
+           s_live->dropped_results(),
+           s_live->realtime ? "" : " (no RT prio)");
+  result += line;
+  return result;
+}
+
+// Print the lines of "status" from "row" on. Each is padded to the
+// length of the same line in "previous", to overwrite it.
+static void show_status(WINDOW *display, int row, const std::string &status,
+                        const std::string &previous = "") {
+  size_t pos = 0, previous_pos = 0;
+  while (pos < status.size()) {
+    const size_t end = status.find('\n', pos);
+    size_t width = end - pos;
+    if (previous_pos < previous.size()) {
+      const size_t previous_end = previous.find('\n', previous_pos);
+      width = std::max(width, previous_end - previous_pos);
+      previous_pos = previous_end + 1;
+    }
+    mvwprintw(display, row++, 0, "%-*s", (int) width,
+              status.substr(pos, end - pos).c_str());
+    pos = end + 1;
+  }
+}
+
+// The first row of the menu, so that it fits at the bottom.
+static int menu_row() {
+  const int rows = 9 + (s_live && s_live->players.size() > 1 ? 1 : 0)
+    + 2;   // Status lines.
+  return LINES - 2 * kPitchDisplay - rows;
 }
 
-static void show_menu(WINDOW *display, int row) {
+// Print the menu from "row" on. Returns the row the status lines start.
+static int show_menu(WINDOW *display, int row) {
   int x = 0;
   wcolor_set(display, COL_HEADLINE, NULL);
   mvwprintw(display, row++, x,  " Shortcuts ");
@@ -214,10 +440,29 @@ static void show_menu(WINDOW *display, int row) {
   mvwprintw(display, row++, x,   " c      : show %s",
             kShowCount ? "percent      " : "raw count");
   wcolor_set(display, COL_NEUTRAL, NULL);
+  if (s_live) {
+    const int seconds = s_live->players[s_player]->recent.seconds();
+    char shows[24];
+    if (s_show_recent) {
+      snprintf(shows, sizeof(shows), "all time");
+    } else if (seconds % 60 == 0) {
+      snprintf(shows, sizeof(shows), "last %dmin", seconds / 60);
+    } else {
+      snprintf(shows, sizeof(shows), "last %ds", seconds);
+    }
+    mvwprintw(display, row++, x, " w      : show %-12s", shows);
+  }
+  if (s_live && s_live->players.size() > 1) {
+    mvwprintw(display, row++, x, " <tab>  : player %d of %d",
+              s_player + 1, (int) s_live->players.size());
+  }
   mvwprintw(display, row++, x, " q      : quit.");
+  show_status(display, row, menu_status());
+  return row;
 }
 
-static void print_percent_per_cutoff(WINDOW *display, int x, int y,
+static void print_percent_per_cutoff(const StatCounter &stats,
+                                     WINDOW *display, int x, int y,
                                      int min_count, int bargraph_width) {
   wcolor_set(display, COL_HEADLINE, NULL);
   mvwprintw(display, y++, x, " Percentage in tune for      ");
@@ -225,11 +470,25 @@ static void print_percent_per_cutoff(WINDOW *display, int x, int y,
   wcolor_set(display, COL_NEUTRAL, NULL);
   x += 1;
   mvwprintw(display, y++, x, "Cent %%-in-tune");
-  for (int threshold = 5; threshold <= 45; threshold += 5) {
+  // All thresholds the keys select, if they fit above the menu; else those
+  // in steps of 5 and the selected one.
+  std::vector<int> thresholds;
+  for (int t = 1; ; t = next_cent_threshold(t)) {
+    thresholds.push_back(t);
+    if (t >= kMaxCentThreshold) break;
+  }
+  if ((int) thresholds.size() > menu_row() - y) {
+    thresholds.erase(std::remove_if(thresholds.begin(), thresholds.end(),
+                                    [](int t) {
+                                      return t % 5 != 0 && t != cent_threshold;
+                                    }),
+                     thresholds.end());
+  }
+  for (int threshold : thresholds) {
     int total_scored = 0;
     int total_in_tune = 0;
-    for (int note = 0; note < sStatCounter.size(); ++note) {
-      StatCounter::Counter counter = sStatCounter.get_stat_for(note, threshold);
+    for (int note = 0; note < stats.size(); ++note) {
+      StatCounter::Counter counter = stats.get_stat_for(note, threshold);
       const int note_count = counter.flat + counter.ok + counter.sharp;
       if (note_count == 0 || note_count <= min_count)
         continue;
@@ -249,7 +508,8 @@ static void print_percent_per_cutoff(WINDOW *display, int x, int y,
   wcolor_set(display, COL_NEUTRAL, NULL);
 }
 
-static void print_stats(WINDOW *display, WINDOW *flat, WINDOW *sharp) {
+static void print_stats(const StatCounter &stats,
+                        WINDOW *display, WINDOW *flat, WINDOW *sharp) {
   int kStartX = 33;
   int kStartY = 3;
   wbkgd(display, COLOR_PAIR(COL_NEUTRAL));
@@ -260,9 +520,8 @@ static void print_stats(WINDOW *display, WINDOW *flat, WINDOW *sharp) {
   // Let's first see how many counts we have, so that we can discard notes
   // that are contributing less than 5% or so
   std::vector<int> percentile_counter;
-  for (int note = 0; note < sStatCounter.size(); ++note) {
-    StatCounter::Counter counter = sStatCounter.get_stat_for(note,
-                                                             cent_threshold);
+  for (int note = 0; note < stats.size(); ++note) {
+    StatCounter::Counter counter = stats.get_stat_for(note, cent_threshold);
     const int count = counter.flat + counter.ok + counter.sharp;
     if (!count) continue;
     percentile_counter.push_back(count);
@@ -278,11 +537,10 @@ static void print_stats(WINDOW *display, WINDOW *flat, WINDOW *sharp) {
   int total_scored = 0, total_in_tune = 0;
   StringBoard board(display, kStartX, kStartY, kStringSpace, kHalftoneSpace);
   board.PrintStringBoard();
-  print_percent_per_cutoff(display, 0, 3, require_min_count, 19);
+  print_percent_per_cutoff(stats, display, 0, 3, require_min_count, 19);
 
-  for (int note = 0; note < sStatCounter.size(); ++note) {
-    StatCounter::Counter counter = sStatCounter.get_stat_for(note,
-                                                             cent_threshold);
+  for (int note = 0; note < stats.size(); ++note) {
+    StatCounter::Counter counter = stats.get_stat_for(note, cent_threshold);
     const int note_count = counter.flat + counter.ok + counter.sharp;
     if (note_count == 0)
       continue;
@@ -298,163 +556,750 @@ static void print_stats(WINDOW *display, WINDOW *flat, WINDOW *sharp) {
                         counter.flat, counter.ok, counter.sharp);
   }
 
-  show_menu(display, LINES - 8 - 2 * kPitchDisplay);
+  show_menu(display, menu_row());
   wrefresh(display);
 }
 
-static void print_freq(double f, int max_value,
-                       WINDOW *display, WINDOW *flat, WINDOW *sharp) {
-  int kStartX = 33;
-  int kStartY = 3;
-  wbkgd(display, COLOR_PAIR(COL_NEUTRAL));
-  wbkgd(flat, COLOR_PAIR(COL_NEUTRAL));
-  wbkgd(sharp, COLOR_PAIR(COL_NEUTRAL));
-  werase(display);
-  werase(flat);
-  werase(sharp);
+// The live pitch display. Only what changed since the last frame is
+// redrawn: the string board and the menu stay, and the note, cent bars,
+// VU meter and status are updated in place. All windows go to the
+// terminal in a single update.
+// Below the frequency, the cent range of the results summarized in the
+// frame and the confidence of the tracking are shown.
+class FreqView {
+public:
+  FreqView(WINDOW *display, WINDOW *flat, WINDOW *sharp)
+    : display_(display), flat_(flat), sharp_(sharp), valid_(false) {}
 
-  show_menu(display, LINES - 8 - 2 * kPitchDisplay);
+  // Something else drew over the windows; start from scratch.
+  void Invalidate() { valid_ = false; }
 
-  StringBoard board(display, kStartX, kStartY, kStringSpace, kHalftoneSpace);
-  board.PrintStringBoard();
+  void Show(const FrameSummary &frame);
+
+private:
+  static const int kStartX = 33;
+  static const int kStartY = 3;
+  static const int kVUWidth = 16;
+
+  // What PrintNote() drew last.
+  struct Marker {
+    bool shown;
+    const char *name;
+    int str, position;
+    bool in_tune;
+    int cent_bar;
+    bool operator==(const Marker &o) const {
+      return shown == o.shown && (!shown || (name == o.name && str == o.str
+                                             && position == o.position
+                                             && in_tune == o.in_tune
+                                             && cent_bar == o.cent_bar));
+    }
+  };
+
+  StringBoard Board() const {
+    return StringBoard(display_, kStartX, kStartY, string_space_,
+                       halftone_space_);
+  }
+  void DrawBackground();
+  void ClearMarker(StringBoard *board);
+
+  WINDOW *const display_;
+  WINDOW *const flat_;
+  WINDOW *const sharp_;
+
+  bool valid_;
+  int lines_, cols_;   // Layout the background was drawn for.
+  int string_space_, halftone_space_;
+  int status_row_;
+  std::string status_;
+  int vu_bar_;         // -1: no meter.
+  std::string freq_text_;
+  std::string summary_text_;
+  Marker marker_;
+  bool flat_warn_, sharp_warn_;
+};
+
+void FreqView::DrawBackground() {
+  lines_ = LINES;
+  cols_ = COLS;
+  string_space_ = kStringSpace;
+  halftone_space_ = kHalftoneSpace;
+  wbkgd(display_, COLOR_PAIR(COL_NEUTRAL));
+  wbkgd(flat_, COLOR_PAIR(COL_NEUTRAL));
+  wbkgd(sharp_, COLOR_PAIR(COL_NEUTRAL));
+  werase(display_);
+  werase(flat_);
+  werase(sharp_);
+  wnoutrefresh(flat_);
+  wnoutrefresh(sharp_);
+  status_row_ = show_menu(display_, menu_row());
+  status_ = menu_status();
+  Board().PrintStringBoard();
+  vu_bar_ = -1;
+  freq_text_.clear();
+  summary_text_.clear();
+  marker_.shown = false;
+  flat_warn_ = sharp_warn_ = false;
+  valid_ = true;
+}
+
+void FreqView::ClearMarker(StringBoard *board) {
+  if (!marker_.shown)
+    return;
+  const int x = board->NoteX(marker_.str);
+  const int y = board->NoteY(marker_.position);
+  for (int row = y - 1; row <= y + 1; ++row) {
+    board->Restore(x, row, StringBoard::kNoteWidth);
+  }
+  marker_.shown = false;
+}
+
+void FreqView::Show(const FrameSummary &frame) {
+  const double f = frame.freq;
+  const int max_value = frame.max_val;
+  if (!valid_ || lines_ != LINES || cols_ != COLS
+      || string_space_ != kStringSpace || halftone_space_ != kHalftoneSpace) {
+    DrawBackground();
+  }
+  StringBoard board = Board();
 
+  int vu_bar = -1;
   if (max_value > 0) {
     const float vu_db = 20 * (log(max_value / 32768.0) / log(10));
     // everything above -20 db we show
     const float kMinDB = -20;
-    const int kVUWidth = 16;
-    mvwprintw(display, 0, 1, "[%*s]", kVUWidth, "");
+    vu_bar = 0;
     if (vu_db > kMinDB) {
-      int vu_bar = kVUWidth * (vu_db - kMinDB) / -kMinDB;
-      mvwchgat(display, 0, 1, vu_bar, 0, COL_VU_METER, NULL);
+      vu_bar = kVUWidth * (vu_db - kMinDB) / -kMinDB;
     }
   }
+  if (vu_bar != vu_bar_) {
+    if (vu_bar < 0) {
+      mvwprintw(display_, 0, 1, "%*s", kVUWidth + 2, "");
+    } else {
+      mvwprintw(display_, 0, 1, "[%*s]", kVUWidth, "");
+      if (vu_bar > 0) mvwchgat(display_, 0, 1, vu_bar, 0, COL_VU_METER, NULL);
+    }
+    vu_bar_ = vu_bar;
+  }
 
-  if (f == 0.0)
-    return;   // nothing detected.
+  Marker marker;
+  marker.shown = false;
+  char freq_text[32] = "";
+  char summary_text[32] = "";
+  bool flat_warn = false, sharp_warn = false;
+  if (f != 0.0) {
+    const NoteInfo note_info = FrequencyToNote(f);
+    const char *name = note_name[s_key_display][note_info.note];
+    if (f < 100) {
+      snprintf(freq_text, sizeof(freq_text), "%5.1fHz %s", f, name);
+    } else {
+      snprintf(freq_text, sizeof(freq_text), "%4.0f Hz %s", f, name);
+    }
+    if (frame.note >= 0 && frame.max_cent - frame.min_cent >= 1) {
+      snprintf(summary_text, sizeof(summary_text), "%+3.0f..%+3.0f cent %3.0f%%",
+               frame.min_cent, frame.max_cent, 100 * frame.confidence);
+    } else {
+      snprintf(summary_text, sizeof(summary_text), "%13s %3.0f%%", "",
+               100 * frame.confidence);
+    }
+    // We're not showing anything outside of our range.
+    if (f >= 64 && f <= 650) {
+      const double cent = note_info.cent;
+      // Each string covers 7 half-tones in 1st pos.
+      marker.shown = true;
+      marker.name = name;
+      marker.str = note_info.scale_above_C / 7;
+      marker.position = note_info.scale_above_C % 7;
+      marker.in_tune = (cent >= -cent_threshold && cent <= cent_threshold);
+      marker.cent_bar = StringBoard::CentBar(cent);
+      flat_warn = kSeizureMode && cent < -cent_threshold;
+      sharp_warn = kSeizureMode && cent > cent_threshold;
+    }
+  }
+  if (freq_text_ != freq_text) {
+    mvwprintw(display_, 1, 1, "%-*s", (int) freq_text_.size(), freq_text);
+    freq_text_ = freq_text;
+  }
+  if (summary_text_ != summary_text) {
+    mvwprintw(display_, 2, 1, "%-*s", (int) summary_text_.size(),
+              summary_text);
+    summary_text_ = summary_text;
+  }
 
-  static const double base = kPitchA / 8; // The A just below our C string.
-  static const double d = exp(log(2) / 1200);
-  const double cent_above_base = log(f / base) / log(d);
-  const int scale_above_C = round(cent_above_base / 100.0) - 3;
+  const std::string status = menu_status();
+  const bool status_changed = (status != status_);
+  // On small terminals, the note can share rows with the menu; it goes on
+  // top then.
+  const bool marker_covered = status_changed && marker_.shown
+    && board.NoteY(marker_.position) + 1 >= status_row_;
+  if (!(marker == marker_) || marker_covered) {
+    ClearMarker(&board);
+  }
+  if (status_changed) {
+    show_status(display_, status_row_, status, status_);
+    status_ = status;
+  }
+  if (marker.shown && !marker_.shown) {
+    board.PrintNote(marker.name, marker.str, marker.position,
+                    marker.in_tune, marker.cent_bar);
+  }
+  marker_ = marker;
 
-  // Press into regular scale
-  double scale = fmod(cent_above_base, 1200.0);
-  scale /= 100.0;
-  int rounded = round(scale);
-  double cent = 100 * (scale - rounded);
-  int note = rounded % 12;   // rounded can be 12.
+  if (flat_warn != flat_warn_) {
+    wbkgd(flat_, COLOR_PAIR(flat_warn ? COL_WARN : COL_NEUTRAL));
+    wnoutrefresh(flat_);
+    flat_warn_ = flat_warn;
+  }
+  if (sharp_warn != sharp_warn_) {
+    wbkgd(sharp_, COLOR_PAIR(sharp_warn ? COL_WARN : COL_NEUTRAL));
+    wnoutrefresh(sharp_);
+    sharp_warn_ = sharp_warn;
+  }
+  wnoutrefresh(display_);
+  doupdate();
+}
 
-  if (f < 100) {
-    mvwprintw(display, 1, 1, "%5.1fHz %s", f, note_name[s_key_display][note]);
+// Distribution of the wavelet levels used, "1:12% 2:40% ..." into "buffer";
+// hops where the pitch was only confirmed used none, detectors other than
+// the wavelet one don't have levels.
+static void format_levels_used(const LivePipeline &live,
+                               char *buffer, size_t size) {
+  uint32_t with_levels = 0;
+  for (int l = 1; l <= kMaxWaveletLevels; ++l)
+    with_levels += live.levels_used[l];
+  const uint32_t total =
+    with_levels + live.levels_used[0] + live.without_levels;
+  int pos = 0;
+  buffer[0] = '\0';
+  if (total > 0) {
+    pos += snprintf(buffer, size, "confirmed:%u%% ",
+                    100 * live.levels_used[0] / total);
+  }
+  if (live.without_levels > 0) {
+    pos += snprintf(buffer + pos, size - pos, "detected:%u%% ",
+                    100 * live.without_levels / total);
+  }
+  for (int l = 1; l <= kMaxWaveletLevels && with_levels > 0; ++l) {
+    pos += snprintf(buffer + pos, size - pos, "%d:%u%% ",
+                    l, 100 * live.levels_used[l] / total);
+    if (pos >= (int) size) break;
+  }
+}
+
+// How the audio is captured, e.g. "mmap, period 512, buffer 2048 frames".
+static void format_capture(const AlsaCapture &capture,
+                           char *buffer, size_t size) {
+  snprintf(buffer, size, "%s, period %d, buffer %d frames",
+           capture.mmap() ? "mmap" : "read", capture.period_frames(),
+           capture.buffer_frames());
+}
+
+// The hidden panel: where the time goes, per stage.
+static void print_timing(const LivePipeline &live,
+                         WINDOW *display, WINDOW *flat, WINDOW *sharp) {
+  wbkgd(display, COLOR_PAIR(COL_NEUTRAL));
+  wbkgd(flat, COLOR_PAIR(COL_NEUTRAL));
+  wbkgd(sharp, COLOR_PAIR(COL_NEUTRAL));
+  werase(flat); wrefresh(flat);
+  werase(sharp); wrefresh(sharp);
+  werase(display);
+  int row = 1;
+  wcolor_set(display, COL_HEADLINE, NULL);
+  mvwprintw(display, row++, 1, " Stage timing (i to close) ");
+  wcolor_set(display, COL_NEUTRAL, NULL);
+  char line[256];
+  for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+    live.stage_time[stage].Summary(line, sizeof(line));
+    mvwprintw(display, row++, 1, "%-13s %s", kStageName[stage], line);
+  }
+  format_levels_used(live, line, sizeof(line));
+  mvwprintw(display, ++row, 1, "wavelet levels used %s", line);
+  format_capture(*live.capture, line, sizeof(line));
+  mvwprintw(display, ++row, 1, "capture %s", line);
+  wrefresh(display);
+}
+
+static void print_timing_report(FILE *out, const LivePipeline &live) {
+  char line[256];
+  fprintf(out, "Stage timing (count, percentiles, max):\n");
+  for (int stage = 0; stage < STAGE_COUNT; ++stage) {
+    live.stage_time[stage].Summary(line, sizeof(line));
+    fprintf(out, "  %-13s %s\n", kStageName[stage], line);
+  }
+  format_levels_used(live, line, sizeof(line));
+  fprintf(out, "  wavelet levels used %s\n", line);
+  format_capture(*live.capture, line, sizeof(line));
+  fprintf(out, "  capture %s\n", line);
+}
+
+// Count a detected frequency in the statistics if it is in our range.
+static void count_freq(Player *player, double f, double now) {
+  if (f < 64 || f > 650)
+    return;
+  const NoteInfo note_info = FrequencyToNote(f);
+  player->stats.Count(note_info.scale_above_C, note_info.cent);
+  player->recent.Count(note_info.scale_above_C, note_info.cent, now);
+}
+
+// Summary of a player's statistics, for the end of the session.
+static void print_report(FILE *out, int player, const StatCounter &stats) {
+  int total_scored = 0, total_in_tune = 0;
+  fprintf(out, "Player %d:\n", player);
+  for (int note = 0; note < stats.size(); ++note) {
+    const StatCounter::Counter c = stats.get_stat_for(note, cent_threshold);
+    const int count = c.flat + c.ok + c.sharp;
+    if (count == 0)
+      continue;
+    // Note 0 is the C string of the cello, C2.
+    fprintf(out, "  %-2s%d %6d counted: %3d%% flat %3d%% in tune "
+            "%3d%% sharp\n", note_name[s_key_display][(note + 3) % 12],
+            2 + note / 12, count, 100 * c.flat / count, 100 * c.ok / count,
+            100 * c.sharp / count);
+    total_scored += count;
+    total_in_tune += c.ok;
+  }
+  if (total_scored == 0) {
+    fprintf(out, "  nothing counted.\n");
   } else {
-    mvwprintw(display, 1, 1, "%4.0f Hz %s", f, note_name[s_key_display][note]);
+    fprintf(out, "  %d%% in tune within %d cent.\n",
+            100 * total_in_tune / total_scored, cent_threshold);
+  }
+}
+
+// Append the statistics of each player since the last reset as a session
+// to "store", and start a new session.
+static void save_sessions(StatsStore *store, const LivePipeline &live) {
+  const time_t now = time(NULL);
+  for (int p = 0; p < (int) live.players.size(); ++p) {
+    Player *const player = live.players[p];
+    const StatCounter::Counter c = player->stats.get_total_for(cent_threshold);
+    if (c.flat + c.ok + c.sharp > 0)
+      store->Append(p, player->session_start, now, player->stats);
+    player->session_start = now;
   }
+}
+
+// "counted, NN% in tune" of "stats" into "buffer".
+static void format_in_tune(const StatCounter &stats,
+                           char *buffer, size_t size) {
+  const StatCounter::Counter c = stats.get_total_for(cent_threshold);
+  const int count = c.flat + c.ok + c.sharp;
+  snprintf(buffer, size, "%7d counted %3d%% in tune", count,
+           count ? 100 * c.ok / count : 0);
+}
+
+// The sessions in "store", and the weeks they were in, for each player.
+static void print_sessions(FILE *out, const StatsStore &store) {
+  char line[64], when[32];
+  fprintf(out, "Sessions (in tune within %d cent):\n", cent_threshold);
+  for (int i = 0; i < store.sessions(); ++i) {
+    if (!store.valid(i)) {
+      fprintf(out, "  session %d is damaged.\n", i + 1);
+      continue;
+    }
+    // The session is the difference to the previous one of the player.
+    const int previous = store.previous(i);
+    if (previous >= 0 && !store.valid(previous)) {
+      snprintf(line, sizeof(line), "lost with the damaged session before");
+    } else {
+      StatCounter stats(kMaxNotesAboveC);
+      store.AddTotals(previous, i, &stats);
+      format_in_tune(stats, line, sizeof(line));
+    }
+    const time_t start = store.start_time(i);
+    strftime(when, sizeof(when), "%Y-%m-%d %H:%M", localtime(&start));
+    fprintf(out, "  %s %4ldmin  player %d %s\n", when,
+            (long) (store.end_time(i) - start + 30) / 60,
+            store.player(i) + 1, line);
+  }
+
+  // A week is the difference of the totals after its last session and
+  // before its first. Weeks before a damaged session are left out.
+  int players = 0;
+  for (int i = 0; i < store.sessions(); ++i) {
+    if (store.valid(i)) players = std::max(players, store.player(i) + 1);
+  }
+  fprintf(out, "Weeks:\n");
+  for (int p = 0; p < players; ++p) {
+    const int last = store.LastSession(p);
+    if (last < 0)
+      continue;
+    std::vector<int> sessions;   // Of this player, oldest first.
+    int i = last;
+    for (; i >= 0 && store.valid(i); i = store.previous(i))
+      sessions.push_back(i);
+    std::reverse(sessions.begin(), sessions.end());
+    int week_before = -1;
+    if (i >= 0) {
+      // Can only take the differences from the first intact one on.
+      week_before = sessions.front();
+      sessions.erase(sessions.begin());
+    }
+    char week[16] = "", session_week[16];
+    int week_end = -1, count = 0;
+    long minutes = 0;
+    for (size_t s = 0; s <= sessions.size(); ++s) {
+      if (s < sessions.size()) {
+        const time_t start = store.start_time(sessions[s]);
+        strftime(session_week, sizeof(session_week), "%G-W%V",
+                 localtime(&start));
+      }
+      if (count > 0 && (s == sessions.size()
+                        || strcmp(session_week, week) != 0)) {
+        StatCounter stats(kMaxNotesAboveC);
+        store.AddTotals(week_before, week_end, &stats);
+        format_in_tune(stats, line, sizeof(line));
+        fprintf(out, "  %s  player %d %3d sessions %5ldmin %s\n", week, p + 1,
+                count, minutes, line);
+        week_before = week_end;
+        count = 0;
+        minutes = 0;
+      }
+      if (s == sessions.size())
+        break;
+      strcpy(week, session_week);
+      week_end = sessions[s];
+      ++count;
+      minutes += (store.end_time(week_end) - store.start_time(week_end) + 30)
+        / 60;
+    }
+  }
+}
 
-  // We're not showing anything outside of our range.
-  if (f < 64 || f > 650) {
-    wrefresh(display);
-    wrefresh(flat);
-    wrefresh(sharp);    
+// How in tune the player was over all sessions in "store".
+static void print_all_sessions_report(FILE *out, int player,
+                                      const StatsStore &store) {
+  const int last = store.LastSession(player - 1);
+  if (last < 0)
     return;
+  StatCounter stats(kMaxNotesAboveC);
+  store.AddTotals(-1, last, &stats);
+  char line[64];
+  format_in_tune(stats, line, sizeof(line));
+  fprintf(out, "Player %d all sessions: %s within %d cent.\n", player,
+          line, cent_threshold);
+}
+
+static void print_latency_report(FILE *out, int player,
+                                 const LatencyStats &l, int sample_rate) {
+  if (l.count == 0)
+    return;
+  fprintf(out, "Player %d latency: %.1fms average, %.1fms max; "
+          "%.0f samples (%.1fms) analyzed on average.\n", player,
+          1000 * l.latency_sum / l.count, 1000 * l.latency_max,
+          l.window_sum / l.count, 1000 * l.window_sum / l.count / sample_rate);
+}
+
+static bool SetRealtimePriority() {
+  struct sched_param param;
+  param.sched_priority = sched_get_priority_min(SCHED_FIFO) + 10;
+  return pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) == 0;
+}
+
+static void CaptureThread(LivePipeline *live) {
+  live->realtime = SetRealtimePriority();
+  const int channels = live->players.size();
+  const int hop_size = live->players[0]->analyzer->hop_size();
+  std::vector<short*> hops(channels);
+  while (!live->do_exit) {
+    int64_t start = MonotonicNanos();
+    if (!live->capture->Wait(hop_size)) {
+      live->capture_failed = true;
+      live->do_exit = true;
+      break;
+    }
+    if (live->do_exit)   // Interrupted.
+      break;
+    start = live->stage_time[STAGE_CAPTURE_WAIT].RecordSince(start);
+    // Each channel goes straight into its analysis window. If that is
+    // full, the device still has to be read to keep it going, but the
+    // hop is dropped.
+    for (int c = 0; c < channels; ++c) {
+      hops[c] = live->players[c]->analyzer->HopToFill();
+    }
+    if (!live->capture->Read(hops.data(), hop_size)) {
+      live->capture_failed = true;
+      live->do_exit = true;
+      break;
+    }
+    for (int c = 0; c < channels; ++c) {
+      Player *const player = live->players[c];
+      if (hops[c] == NULL) {
+        player->dropped_hops++;
+        continue;
+      }
+      player->analyzer->HopFilled();
+      sem_post(&player->samples_ready);
+    }
+    live->stage_time[STAGE_CONVERT].RecordSince(start);
+  }
+  for (Player *p : live->players) {
+    sem_post(&p->samples_ready);     // Make sure analysis sees exit.
   }
+  live->PostResults();               // .. and the UI.
+}
+
+static void AnalysisThread(LivePipeline *live, Player *player) {
+  while (!live->do_exit) {
+    sem_wait(&player->samples_ready);
+    while (player->analyzer->NextWindow()) {
+      AnalysisResult result;
+      result.max_val = player->analyzer->PeakOfNewestHop();
+      result.freq = 0.0;
+      result.window = 0;
+      result.latency = 0.0;
+      result.confidence = 0.0;
+      if (!paused && result.max_val > PitchAnalyzer::kMinLoudness) {
+        PitchAnalyzer *const analyzer = player->analyzer;
+        result.freq = analyzer->ComputePitch();
+        result.window = analyzer->analyzed_samples();
+        result.latency = analyzer->processing_latency();
+        result.confidence = analyzer->confidence();
+        live->stage_time[STAGE_DETECTOR].Record(analyzer->detector_nanos());
+        live->stage_time[STAGE_DYNAMIC].Record(analyzer->dynamic_nanos());
+        const int levels = analyzer->levels_used();
+        if (levels < 0)
+          live->without_levels.fetch_add(1, std::memory_order_relaxed);
+        else if (levels <= kMaxWaveletLevels)
+          live->levels_used[levels].fetch_add(1, std::memory_order_relaxed);
+      }
+      if (player->results.Push(result)) {
+        live->PostResults();
+      } else {
+        player->dropped_results++;
+      }
+    }
+  }
+}
 
-  bool in_tune = true;
-  if (cent < - cent_threshold) {
-    if (kSeizureMode) wbkgd(flat, COLOR_PAIR(COL_WARN));
-    wbkgd(sharp, COLOR_PAIR(COL_NEUTRAL));
-    in_tune = false;
+// Listen on unix socket "path" for keys from other programs, e.g. a foot
+// switch. Returns the listening socket, or -1 after printing why not.
+static int OpenKeySocket(const char *path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "Socket path too long: %s\n", path);
+    return -1;
   }
-  else if (cent > cent_threshold) {
-    wbkgd(flat, COLOR_PAIR(COL_NEUTRAL));
-    if (kSeizureMode) wbkgd(sharp, COLOR_PAIR(COL_WARN));
-    in_tune = false;
+  strcpy(addr.sun_path, path);
+  // One left over from an earlier run is in the way; anything else stays.
+  struct stat st;
+  if (stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) unlink(path);
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                        0);
+  if (fd < 0 || bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0
+      || listen(fd, 4) < 0) {
+    fprintf(stderr, "Can't listen on %s: %s\n", path, strerror(errno));
+    if (fd >= 0) close(fd);
+    return -1;
   }
-  sStatCounter.Count(scale_above_C, cent);
-  wrefresh(flat);
-  wrefresh(sharp);
+  return fd;
+}
 
-  // Each string covers 7 half-tones in 1st pos.
-  const int cello_string = scale_above_C / 7;
-  const int pitch_pos = scale_above_C % 7;
-  board.PrintNote(note_name[s_key_display][note], cello_string, pitch_pos,
-                  in_tune, cent);
-  wrefresh(display);
+static int usage(const char *progname) {
+  fprintf(stderr, "usage: %s [options] [<pcm-device>]\n", progname);
+  fprintf(stderr, "Options:\n"
+          "\t-f <file>  : Analyze WAV or raw S16_LE file ('-' for stdin) "
+          "as fast\n"
+          "\t             as possible; print pitch per hop to stdout.\n"
+          "\t-r <rate>  : Sample rate to capture at; also of raw input "
+          "this file.\n"
+          "\t             (default 44100).\n"
+          "\t-n <chan>  : Channels to capture, one player each; also of "
+          "raw\n"
+          "\t             input files (default 1).\n"
+          "\t-j <num>   : Threads used for file analysis (default: "
+          "all cores).\n"
+          "\t-e <name>  : Pitch detection engine: wavelet, yin or mpm "
+          "(default\n"
+          "\t             wavelet).\n"
+          "\t-p <prec>  : Precision of the wavelet computation: double, "
+          "float\n"
+          "\t             or fixed (default double).\n"
+          "\t-F         : Always analyze the full window, instead of "
+          "shrinking it\n"
+          "\t             for higher notes to lower latency.\n"
+          "\t-C         : Run the pitch detection for every hop, instead "
+          "of\n"
+          "\t             confirming a held pitch with less work.\n"
+          "\t-R <fps>   : Update the display at most this often "
+          "(default %d).\n"
+          "\t-s <file>  : Keep the statistics of each live session in "
+          "this file.\n"
+          "\t-l         : List the sessions in the file given with -s "
+          "and exit.\n"
+          "\t-w <sec>   : Length of the recent statistics shown with 'w' "
+          "(default %d).\n"
+          "\t-P <frames>: Capture period size; smaller lowers the latency "
+          "(default:\n"
+          "\t             the device's choice).\n"
+          "\t-B <frames>: Capture buffer size (default: the device's "
+          "choice).\n"
+          "\t-M         : Read the samples from the device instead of "
+          "taking them\n"
+          "\t             from its buffer with mmap.\n"
+          "\t-k <path>  : Also take keys from connections to unix socket "
+          "<path>,\n"
+          "\t             one character each, e.g. from a foot switch.\n",
+          kDefaultFramesPerSecond, kDefaultRecentSeconds);
+  return 1;
 }
 
-static unsigned int kSampleRate = 44100;
 int main (int argc, char *argv[]) {
-  int err;
-  snd_pcm_t *capture_handle = NULL;
-  snd_pcm_hw_params_t *hw_params = NULL;
-
   const char* pcm_device = "default";
+  const char *input_file = NULL;
+  unsigned int sample_rate = 44100;
+  int channels = 1;
+  int threads = std::thread::hardware_concurrency();
+  const char *engine = PitchDetector::kEngines[0];
+  dywapitch_precision precision = DYWAPITCH_DOUBLE;
+  bool adaptive_window = true;
+  bool confirm_pitch = true;
+  int frames_per_second = kDefaultFramesPerSecond;
+  const char *stats_file = NULL;
+  bool list_sessions = false;
+  int recent_seconds = kDefaultRecentSeconds;
+  int period_frames = 0;
+  int buffer_frames = 0;
+  bool use_mmap = true;
+  const char *key_socket_path = NULL;
 
-  if (argc > 2) {
-    fprintf(stderr, "usage: %s <pcm-device>\n", argv[0]);
-    return 1;
+  int opt;
+  while ((opt = getopt(argc, argv, "f:r:n:j:e:p:FCR:s:lw:P:B:Mk:")) != -1) {
+    switch (opt) {
+    case 'f': input_file = optarg; break;
+    case 'r': sample_rate = atoi(optarg); break;
+    case 'n': channels = atoi(optarg); break;
+    case 'j': threads = atoi(optarg); break;
+    case 'F': adaptive_window = false; break;
+    case 'C': confirm_pitch = false; break;
+    case 'R': frames_per_second = atoi(optarg); break;
+    case 's': stats_file = optarg; break;
+    case 'l': list_sessions = true; break;
+    case 'w': recent_seconds = atoi(optarg); break;
+    case 'P': period_frames = atoi(optarg); break;
+    case 'B': buffer_frames = atoi(optarg); break;
+    case 'M': use_mmap = false; break;
+    case 'k': key_socket_path = optarg; break;
+    case 'e':
+      engine = NULL;
+      for (const char *name : PitchDetector::kEngines) {
+        if (strcmp(optarg, name) == 0) engine = name;
+      }
+      if (engine == NULL) {
+        fprintf(stderr, "Unknown pitch detection engine '%s'.\n", optarg);
+        return usage(argv[0]);
+      }
+      break;
+    case 'p':
+      if (strcmp(optarg, "double") == 0) precision = DYWAPITCH_DOUBLE;
+      else if (strcmp(optarg, "float") == 0) precision = DYWAPITCH_FLOAT;
+      else if (strcmp(optarg, "fixed") == 0) precision = DYWAPITCH_FIXED;
+      else {
+        fprintf(stderr, "Unknown precision '%s'.\n", optarg);
+        return usage(argv[0]);
+      }
+      break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+  if (argc - optind > 1) {
+    return usage(argv[0]);
+  }
+  if (argc > optind) {
+    pcm_device = argv[optind];
+  }
+  if ((int) sample_rate < PitchAnalyzer::kMinSampleRate
+      || (int) sample_rate > PitchAnalyzer::kMaxSampleRate) {
+    fprintf(stderr, "Sample rate needs to be between %d and %d.\n",
+            PitchAnalyzer::kMinSampleRate, PitchAnalyzer::kMaxSampleRate);
+    return usage(argv[0]);
   }
-  if (argc > 1) {
-    pcm_device = argv[1];
+  if (channels < 1) {
+    fprintf(stderr, "Need at least one channel.\n");
+    return usage(argv[0]);
+  }
+  if (recent_seconds < 1) {
+    fprintf(stderr, "Recent statistics need at least one second.\n");
+    return usage(argv[0]);
+  }
+  if (frames_per_second < 1) {
+    fprintf(stderr, "Need at least one frame per second.\n");
+    return usage(argv[0]);
+  }
+  if (period_frames < 0 || buffer_frames < 0) {
+    fprintf(stderr, "Period and buffer size can't be negative.\n");
+    return usage(argv[0]);
   }
 
-  if ((err = snd_pcm_open (&capture_handle, pcm_device, SND_PCM_STREAM_CAPTURE, 0)) < 0) {
-    fprintf (stderr, "cannot open audio device %s (%s)\n", 
-             argv[1],
-             snd_strerror (err));
-    return 1;
+  if (list_sessions && stats_file == NULL) {
+    fprintf(stderr, "-l needs the file to list with -s.\n");
+    return usage(argv[0]);
   }
-		   
-  if ((err = snd_pcm_hw_params_malloc (&hw_params)) < 0) {
-    fprintf (stderr, "cannot allocate hardware parameter structure (%s)\n",
-             snd_strerror (err));
-    return 1;
+
+  StatsStore *store = NULL;
+  if (stats_file != NULL) {
+    store = StatsStore::Open(stats_file, kMaxNotesAboveC,
+                             StatCounter::kBuckets);
+    if (store == NULL) return 1;
   }
-				 
-  if ((err = snd_pcm_hw_params_any (capture_handle, hw_params)) < 0) {
-    fprintf (stderr, "cannot initialize hardware parameter structure (%s)\n",
-             snd_strerror (err));
-    return 1;
+  if (list_sessions) {
+    print_sessions(stdout, *store);
+    delete store;
+    return 0;
   }
-	
-  if ((err = snd_pcm_hw_params_set_access (capture_handle, hw_params, SND_PCM_ACCESS_RW_INTERLEAVED)) < 0) {
-    fprintf (stderr, "cannot set access type (%s)\n",
-             snd_strerror (err));
-    return 1;
+  if (input_file != NULL && store != NULL) {
+    fprintf(stderr, "Statistics are only kept when listening live.\n");
+    delete store;
+    return usage(argv[0]);
   }
-	
-  if ((err = snd_pcm_hw_params_set_format (capture_handle, hw_params, SND_PCM_FORMAT_S16_LE)) < 0) {
-    fprintf (stderr, "cannot set sample format (%s)\n",
-             snd_strerror (err));
-    return 1;
+  if (input_file != NULL && key_socket_path != NULL) {
+    fprintf(stderr, "Keys are only taken when listening live.\n");
+    delete store;
+    return usage(argv[0]);
   }
-	
-  if ((err = snd_pcm_hw_params_set_rate_near(capture_handle,
-                                             hw_params, &kSampleRate, 0)) < 0) {
-    fprintf (stderr, "cannot set sample rate (%s)\n",
-             snd_strerror (err));
-    return 1;
+
+  if (input_file != NULL) {
+    AudioFile *in = AudioFile::Open(input_file, sample_rate, channels);
+    if (in == NULL) return 1;
+    if ((int) in->sample_rate() < PitchAnalyzer::kMinSampleRate
+        || (int) in->sample_rate() > PitchAnalyzer::kMaxSampleRate) {
+      fprintf(stderr, "%s: sample rate of %u Hz; needs to be between "
+              "%d and %d.\n", input_file, in->sample_rate(),
+              PitchAnalyzer::kMinSampleRate, PitchAnalyzer::kMaxSampleRate);
+      delete in;
+      return 1;
+    }
+    const bool success = RunOfflineAnalysis(in, threads, engine, precision,
+                                            stdout);
+    delete in;
+    return success ? 0 : 1;
   }
-	
-  if ((err = snd_pcm_hw_params_set_channels (capture_handle, hw_params, 1)) < 0) {
-    fprintf (stderr, "cannot set channel count (%s)\n",
-             snd_strerror (err));
+
+  AlsaCapture *capture = AlsaCapture::Open(pcm_device, sample_rate, channels,
+                                           period_frames, buffer_frames,
+                                           use_mmap);
+  if (capture == NULL) {
+    delete store;
     return 1;
   }
-	
-  if ((err = snd_pcm_hw_params (capture_handle, hw_params)) < 0) {
-    fprintf (stderr, "cannot set parameters (%s)\n",
-             snd_strerror (err));
-    return 1;
+  if (capture->sample_rate() != sample_rate) {
+    fprintf(stderr, "Device uses %u Hz instead of %u Hz.\n",
+            capture->sample_rate(), sample_rate);
   }
-	
-  snd_pcm_hw_params_free (hw_params);
-	
-  if ((err = snd_pcm_prepare (capture_handle)) < 0) {
-    fprintf (stderr, "cannot prepare audio interface for use (%s)\n",
-             snd_strerror (err));
+  int key_socket = -1;
+  if (key_socket_path != NULL
+      && (key_socket = OpenKeySocket(key_socket_path)) < 0) {
+    delete capture;
+    delete store;
     return 1;
   }
+  int sample_count, small_sample;
+  PitchAnalyzer::SizesForRate(capture->sample_rate(),
+                              &sample_count, &small_sample);
 
   initscr();
   start_color();
@@ -472,44 +1317,45 @@ int main (int argc, char *argv[]) {
                                       LINES - kPitchDisplay, 0);
   WINDOW *display = newwin(LINES - 2 * kPitchDisplay, COLS,
                            kPitchDisplay, 0);
-  nodelay(display, true);   // don't block for keypresses
+  nodelay(display, true);   // Only read the keys that are there.
   keypad(display, TRUE);   // make complex keys such as cursor work.
 
-  const int sample_count = 2 * dywapitch_neededsamplecount(60);
   fprintf(stderr, "Using %d samples.\n", sample_count);
-  dywapitchtracker tracker;
-  dywapitch_inittracking(&tracker, sample_count);
-  int small_sample = sample_count / 16;
-  short *read_buf = new short [ small_sample ];
-  double *analyze_buf = new double [ sample_count ];
+  LivePipeline live(capture);
+  for (int c = 0; c < channels; ++c) {
+    PitchAnalyzer *analyzer = new PitchAnalyzer(sample_count, small_sample,
+                                                capture->sample_rate());
+    analyzer->set_detector(engine);
+    analyzer->set_precision(precision);
+    analyzer->set_adaptive_window(adaptive_window);
+    analyzer->set_confirm_pitch(confirm_pitch);
+    live.players.push_back(new Player(analyzer, recent_seconds));
+  }
+  s_live = &live;
+  std::vector<std::thread> analysis_threads;
+  for (Player *player : live.players) {
+    analysis_threads.push_back(std::thread(AnalysisThread, &live, player));
+  }
+  std::thread capture_thread(CaptureThread, &live);
+
+  // The main thread does the UI. It sleeps until there are results, keys,
+  // or a timer for something to show at a certain time.
+  EventLoop events;
+  FreqView freq_view(display, flat_pitch, sharp_pitch);
   bool any_change = true;
+  bool show_stats = false;
   double last_keypress_time = -1;
-  double last_minloud_time = -1;
-  bool do_exit = false;
-  while (!do_exit) {
-    kStringSpace = COLS / 8;
-    kHalftoneSpace = LINES / 8;
-    if ((err = snd_pcm_readi (capture_handle, read_buf,
-                              small_sample)) != small_sample) {
-      fprintf (stderr, "read from audio interface failed (%s)\n",
-               snd_strerror (err));
-      return 1;
-    }
-    const int tail_buffer = sample_count - small_sample;
-    memmove(analyze_buf, analyze_buf + small_sample,
-            sizeof(double) * (tail_buffer));
-    int max_val = 0;
-    for (int i = 0; i < small_sample; ++i) {
-      if (abs(read_buf[i]) > max_val)
-        max_val = abs(read_buf[i]);
-      analyze_buf[tail_buffer + i] = read_buf[i] / 32768.0;
-    }
-
-    // Now, let's first check for keypresses that happened in the meantime.
-    // The do create some keyboard noise, so if we detect one, then we will
-    // not count this sample.
-    bool key_pressed = true;
-    switch (wgetch(display)) {
+  double last_timing_time = -1;
+  double last_stats_time = -1;
+  // Results of the selected player not shown yet.
+  const double frame_seconds = 1.0 / frames_per_second;
+  FrameSummary pending;
+  double last_frame_time = -1;
+
+  // Keys do create some keyboard noise, so results right after one are
+  // not counted.
+  auto handle_key = [&](int key) {
+    switch (key) {
     case 'b': case 'B':
       s_key_display = DISPLAY_FLAT;
       break;
@@ -517,57 +1363,222 @@ int main (int argc, char *argv[]) {
       s_key_display = DISPLAY_SHARP;
       break;
     case ' ':
-      sStatCounter.Reset();
+      if (store) save_sessions(store, live);
+      for (Player *player : live.players) {
+        player->stats.Reset();
+        player->recent.Reset();
+      }
+      break;
+    case 'w':
+      s_show_recent = !s_show_recent;
+      break;
+    case '\t':
+      s_player = (s_player + 1) % live.players.size();
       break;
     case 'c':
       kShowCount = !kShowCount;
       break;
+    case 'i':
+      s_show_timing = !s_show_timing;
+      last_timing_time = -1;
+      break;
     case 'p':
       paused = !paused;
       break;
     case KEY_DOWN:
-      if (cent_threshold < 45) cent_threshold += 5;
+      cent_threshold = next_cent_threshold(cent_threshold);
       break;
     case KEY_UP:
-      if (cent_threshold > 5) cent_threshold -= 5;
+      cent_threshold = previous_cent_threshold(cent_threshold);
       break;
     case 'q':
-      do_exit = true;
-      break;
-    case ERR:
-      key_pressed = false;
+      live.do_exit = true;
       break;
     }
-    if (key_pressed) {
-      last_keypress_time = GetTime();
-      any_change = true;
-    }
+    last_keypress_time = GetTime();
+    any_change = true;
+    freq_view.Invalidate();
+  };
 
-    // No value 'heard', show statistics. Also, if we just pressed a key,
-    // that might have created some noise we picked up; ignore that.
+  // Counts new results and draws what is due; then sets the timer for
+  // what will be due next.
+  int redraw_timer = -1;
+  auto update = [&]() {
+    if (live.do_exit) {   // Quit, or the capture failed.
+      events.Quit();
+      return;
+    }
+    kStringSpace = COLS / 8;
+    kHalftoneSpace = LINES / 8;
     const double now = GetTime();
-    const bool min_loud = (max_val > 2000);
-    if (min_loud) {
-      last_minloud_time = now;
-    }
-    if (paused
-        || (last_minloud_time + 1.0 < now)  // at least silent time
-        || (last_keypress_time > 0 && last_keypress_time + 0.5 > now)) {
-      if (any_change) {
-        print_stats(display, flat_pitch, sharp_pitch);
+
+    // Every result is counted; the ones of the selected player are
+    // summarized until it is time for the next frame.
+    AnalysisResult result;
+    for (int p = 0; p < (int) live.players.size(); ++p) {
+      Player *const player = live.players[p];
+      while (player->results.Pop(&result)) {
+        // No value 'heard', show statistics. Also, if we just pressed a key,
+        // that might have created some noise we picked up; ignore that.
+        const bool min_loud = (result.max_val > PitchAnalyzer::kMinLoudness);
+        if (min_loud) {
+          player->last_minloud_time = now;
+        }
+        const bool silent = (paused
+                             || (player->last_minloud_time + 1.0 < now)
+                             || (last_keypress_time > 0
+                                 && last_keypress_time + 0.5 > now));
+        if (!silent) {
+          count_freq(player, result.freq, now);
+        }
+        if (result.window > 0) {
+          player->latency.Count(result, capture->sample_rate());
+        }
+        if (p != s_player)
+          continue;
+        show_stats = silent;
+        if (silent) {
+          pending.Reset();
+        } else {
+          pending.Add(result);
+        }
+      }
+    }
+    const int64_t render_start = MonotonicNanos();
+    double next_due = 0;
+    if (s_show_timing) {
+      // Numbers changing faster than this can't be read anyway.
+      if (now - last_timing_time > 0.25) {
+        print_timing(live, display, flat_pitch, sharp_pitch);
+        last_timing_time = now;
+      }
+      any_change = true;
+      freq_view.Invalidate();
+      next_due = last_timing_time + 0.25;
+    } else if (show_stats) {
+      // Recent statistics change with time, even if nothing is counted.
+      Player *const player = live.players[s_player];
+      if (any_change || (s_show_recent && now - last_stats_time >= 1.0)) {
+        player->recent.Expire(now);
+        print_stats(s_show_recent ? player->recent.stats() : player->stats,
+                    display, flat_pitch, sharp_pitch);
+        live.stage_time[STAGE_RENDER].RecordSince(render_start);
+        freq_view.Invalidate();
+        last_stats_time = now;
       }
       any_change = false;
+      if (s_show_recent) next_due = last_stats_time + 1.0;
+    } else if (pending.count > 0) {
+      if (now - last_frame_time >= frame_seconds) {
+        freq_view.Show(pending);
+        live.stage_time[STAGE_RENDER].RecordSince(render_start);
+        pending.Reset();
+        last_frame_time = now;
+        any_change = true;
+      } else {
+        next_due = last_frame_time + frame_seconds;
+      }
+    }
+    if (next_due > 0) {
+      // Timers don't expire early, so this is enough to be due then.
+      events.StartTimer(redraw_timer, std::max(next_due - now, 1e-6));
     } else {
-      double freq = 0.0;
-      if (min_loud) {
-        freq = dywapitch_computepitch(&tracker, analyze_buf);
+      events.StartTimer(redraw_timer, 0);
+    }
+  };
+
+  redraw_timer = events.CreateTimer(update);
+  events.AddFd(live.results_ready, [&]() {
+      eventfd_t count;
+      eventfd_read(live.results_ready, &count);
+      update();
+    });
+  events.AddFd(STDIN_FILENO, [&]() {
+      int key = wgetch(display);
+      // Readable, but nothing to read: the terminal hung up, or stdin is at
+      // its end, and would stay readable. Without the key socket, there is
+      // no way left to quit.
+      int available;
+      if (key == ERR && (ioctl(STDIN_FILENO, FIONREAD, &available) < 0
+                         || available == 0)) {
+        events.RemoveFd(STDIN_FILENO);
+        if (key_socket < 0) live.do_exit = true;
       }
-      print_freq(freq, max_val, display, flat_pitch, sharp_pitch);
-      any_change = true;
+      for (; key != ERR; key = wgetch(display)) handle_key(key);
+      update();
+    });
+  // Each byte from a connection to the key socket is a key.
+  std::vector<int> key_clients;
+  auto read_keys = [&](int fd) {
+    char keys[64];
+    const ssize_t r = read(fd, keys, sizeof(keys));
+    if (r < 0 && errno == EAGAIN)
+      return;
+    if (r <= 0) {
+      events.RemoveFd(fd);
+      key_clients.erase(std::find(key_clients.begin(), key_clients.end(),
+                                  fd));
+      close(fd);
+      return;
     }
+    for (ssize_t i = 0; i < r; ++i) {
+      if (keys[i] != '\n' && keys[i] != '\r') handle_key(keys[i]);
+    }
+    update();
+  };
+  if (key_socket >= 0) {
+    events.AddFd(key_socket, [&]() {
+        int client;
+        while ((client = accept4(key_socket, NULL, NULL,
+                                 SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+          key_clients.push_back(client);
+          events.AddFd(client, [&read_keys, client]() { read_keys(client); });
+        }
+      });
   }
-	
+  const bool events_ok = redraw_timer >= 0 && events.Run();
+  const int events_error = errno;
+  for (int client : key_clients) close(client);
+  if (key_socket >= 0) {
+    close(key_socket);
+    unlink(key_socket_path);
+  }
+
+  live.do_exit = true;
+  capture->Interrupt();
+  capture_thread.join();
+  for (std::thread &t : analysis_threads) t.join();
+  s_live = NULL;
+
   endwin();
-  snd_pcm_close(capture_handle);
-  return 0;
+  if (live.capture_failed) {
+    fprintf (stderr, "read from audio interface failed (%s)\n",
+             snd_strerror (capture->last_error()));
+  }
+  if (!events_ok) {
+    fprintf(stderr, "waiting for events failed (%s)\n",
+            strerror(events_error));
+  }
+  fprintf(stderr, "%d overruns, %d hops dropped by analysis, "
+          "%d results dropped by UI.\n", capture->xruns(),
+          live.dropped_hops(), live.dropped_results());
+  for (int p = 0; p < (int) live.players.size(); ++p) {
+    print_latency_report(stderr, p + 1, live.players[p]->latency,
+                         capture->sample_rate());
+  }
+  print_timing_report(stderr, live);
+  if (store) {
+    save_sessions(store, live);
+    for (int p = 0; p < (int) live.players.size(); ++p) {
+      print_all_sessions_report(stderr, p + 1, *store);
+    }
+  }
+  if (live.players.size() > 1) {
+    for (int p = 0; p < (int) live.players.size(); ++p) {
+      print_report(stdout, p + 1, live.players[p]->stats);
+    }
+  }
+  delete capture;
+  delete store;
+  return live.capture_failed || !events_ok ? 1 : 0;
 }
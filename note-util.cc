@@ -0,0 +1,25 @@
+#include "note-util.h"
+
+#include <math.h>
+
+const char *note_name[2][12] = {
+  { "A", "Bb", "B", "C", "Db", "D", "Eb", "E", "F", "Gb", "G", "Ab" },
+  { "A", "A#", "B", "C", "C#", "D", "D#", "E", "F", "F#", "G", "G#" },
+};
+
+NoteInfo FrequencyToNote(double f) {
+  static const double base = kPitchA / 8; // The A just below our C string.
+  static const double d = exp(log(2) / 1200);
+  const double cent_above_base = log(f / base) / log(d);
+
+  NoteInfo result;
+  result.scale_above_C = round(cent_above_base / 100.0) - 3;
+
+  // Press into regular scale
+  double scale = fmod(cent_above_base, 1200.0);
+  scale /= 100.0;
+  int rounded = round(scale);
+  result.cent = 100 * (scale - rounded);
+  result.note = rounded % 12;   // rounded can be 12.
+  return result;
+}
@@ -0,0 +1,21 @@
+#ifndef PITCH_HERO_NOTE_UTIL_H
+#define PITCH_HERO_NOTE_UTIL_H
+
+static const double kPitchA = 440.0; // Hz.
+
+enum KeyDisplay {
+  DISPLAY_FLAT,
+  DISPLAY_SHARP,
+};
+extern const char *note_name[2][12];
+
+struct NoteInfo {
+  int scale_above_C;   // Halftones above the cello C string.
+  int note;            // Index into note_name[]; 0 is A.
+  double cent;         // Deviation from the tempered note.
+};
+
+// Map a frequency in Hz to the closest note in equal temperament.
+NoteInfo FrequencyToNote(double f);
+
+#endif  // PITCH_HERO_NOTE_UTIL_H
@@ -0,0 +1,287 @@
+#include "offline-analysis.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "audio-file.h"
+#include "dywapitchtrack.h"
+#include "note-util.h"
+#include "pitch-analyzer.h"
+#include "pitch-detector.h"
+
+// Hops handed to a thread at a time. Large enough to amortize the
+// synchronization, small enough to balance load between threads.
+static const int kHopsPerTask = 16;
+
+static double GetMonotonicTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Frequency, note and cent columns of one channel.
+static void PrintPitch(FILE *out, double f) {
+  if (f == 0.0) {
+    fprintf(out, "\t0\t-\t0");
+    return;
+  }
+  const NoteInfo n = FrequencyToNote(f);
+  fprintf(out, "\t%.2f\t%s\t%+.1f",
+          f, note_name[DISPLAY_SHARP][n.note], n.cent);
+}
+
+namespace {
+// Computes the raw pitch of a batch of hops on a pool of threads.
+//
+// The raw pitch of a hop only depends on the samples in its window, so
+// hops are independent of each other. Only the cheap dynamic post-process
+// carries state from hop to hop; the caller replays it in order, so the
+// result is identical to the serial run.
+class BatchAnalyzer {
+public:
+  BatchAnalyzer(int window_size, int hop_size, int sample_rate, int threads,
+                const char *engine, dywapitch_precision precision)
+    : window_size_(window_size), hop_size_(hop_size), sample_rate_(sample_rate),
+      engine_(engine), precision_(precision), workers_(threads), exit_(false), generation_(0), busy_(0) {
+    for (int i = 1; i < threads; ++i) {
+      threads_.push_back(std::thread(&BatchAnalyzer::ThreadLoop, this, i));
+    }
+  }
+
+  ~BatchAnalyzer() {
+    {
+      std::lock_guard<std::mutex> l(mutex_);
+      exit_ = true;
+    }
+    start_.notify_all();
+    for (std::thread &t : threads_) t.join();
+  }
+
+  // For each of the "channels", "samples[c]" contains window_size - hop_size
+  // samples of history followed by "hops" new hops. Fills "max_val[c]" and
+  // "raw_pitch[c]" for each hop; the pitch is only computed for hops loud
+  // enough to be analyzed.
+  void Analyze(const short *const *samples, int channels, int hops,
+               int *const *max_val, double *const *raw_pitch) {
+    samples_ = samples;
+    channels_ = channels;
+    hops_ = hops;
+    tasks_per_channel_ = (hops + kHopsPerTask - 1) / kHopsPerTask;
+    max_val_ = max_val;
+    raw_pitch_ = raw_pitch;
+    next_task_ = 0;
+    {
+      std::lock_guard<std::mutex> l(mutex_);
+      busy_ = threads_.size();
+      ++generation_;
+    }
+    start_.notify_all();
+    ProcessTasks(&workers_[0]);
+    std::unique_lock<std::mutex> l(mutex_);
+    done_.wait(l, [this]() { return busy_ == 0; });
+  }
+
+private:
+  struct Worker {
+    Worker() : detector(NULL) {}
+    ~Worker() { delete detector; }
+    PitchDetector *detector;       // Created by the thread using it.
+  };
+
+  void ThreadLoop(int id) {
+    int seen_generation = 0;
+    for (;;) {
+      {
+        std::unique_lock<std::mutex> l(mutex_);
+        start_.wait(l, [&]() {
+            return exit_ || generation_ != seen_generation;
+          });
+        if (exit_) return;
+        seen_generation = generation_;
+      }
+      ProcessTasks(&workers_[id]);
+      {
+        std::lock_guard<std::mutex> l(mutex_);
+        --busy_;
+      }
+      done_.notify_one();
+    }
+  }
+
+  void ProcessTasks(Worker *w) {
+    if (w->detector == NULL) {
+      w->detector = PitchDetector::Create(engine_, window_size_, sample_rate_);
+      w->detector->set_precision(precision_);
+    }
+    int task;
+    while ((task = next_task_.fetch_add(1)) < channels_ * tasks_per_channel_) {
+      const int c = task / tasks_per_channel_;
+      const int start = (task % tasks_per_channel_) * kHopsPerTask;
+      const int end = std::min(hops_, start + kHopsPerTask);
+      // Within a task, the detector can reuse the work on the previous hop.
+      int last_analyzed = -1;
+      for (int h = start; h < end; ++h) {
+        const int advanced =
+          last_analyzed < 0 ? 0 : (h - last_analyzed) * hop_size_;
+        if (AnalyzeHop(w, c, h, advanced))
+          last_analyzed = h;
+      }
+    }
+  }
+
+  // Returns true if the pitch detector looked at the window. "advanced" is
+  // how far it moved since the last one it looked at; 0 if unrelated.
+  bool AnalyzeHop(Worker *w, int c, int h, int advanced) {
+    const short *window = samples_[c] + h * hop_size_;
+    const short *hop = window + window_size_ - hop_size_;
+    int max_val = 0;
+    for (int i = 0; i < hop_size_; ++i) {
+      if (abs(hop[i]) > max_val)
+        max_val = abs(hop[i]);
+    }
+    max_val_[c][h] = max_val;
+    raw_pitch_[c][h] = 0.0;
+    if (max_val <= PitchAnalyzer::kMinLoudness)
+      return false;
+    raw_pitch_[c][h] = w->detector->ComputePitch(window, advanced);
+    return true;
+  }
+
+  const int window_size_;
+  const int hop_size_;
+  const int sample_rate_;
+  const char *const engine_;
+  const dywapitch_precision precision_;
+  std::vector<Worker> workers_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable start_;
+  std::condition_variable done_;
+  bool exit_;
+  int generation_;
+  int busy_;
+
+  // Current batch.
+  const short *const *samples_;
+  int channels_;
+  int hops_;
+  int tasks_per_channel_;
+  int *const *max_val_;
+  double *const *raw_pitch_;
+  std::atomic<int> next_task_;
+};
+}  // namespace
+
+bool RunOfflineAnalysis(AudioFile *in, int threads, const char *engine,
+                        dywapitch_precision precision, FILE *out) {
+  int window_size, hop_size;
+  PitchAnalyzer::SizesForRate(in->sample_rate(), &window_size, &hop_size);
+  const int channels = in->channels();
+  if (threads < 1) threads = 1;
+
+  BatchAnalyzer analyzer(window_size, hop_size, in->sample_rate(), threads,
+                         engine, precision);
+
+  // Per channel: the window history, followed by the hops of the current
+  // batch, and the results of the batch.
+  const int history = window_size - hop_size;
+  const int batch_hops = std::max(1, threads / channels) * kHopsPerTask * 4;
+  std::vector<std::vector<short> > samples(channels);
+  std::vector<std::vector<int> > max_val(channels);
+  std::vector<std::vector<double> > raw_pitch(channels);
+  std::vector<const short*> samples_ptr(channels);
+  std::vector<int*> max_val_ptr(channels);
+  std::vector<double*> raw_pitch_ptr(channels);
+  // Each channel carries its own dynamic tracking state.
+  std::vector<dywapitchtracker> trackers(channels);
+  for (int c = 0; c < channels; ++c) {
+    samples[c].resize(history + batch_hops * hop_size, 0);
+    max_val[c].resize(batch_hops);
+    raw_pitch[c].resize(batch_hops);
+    samples_ptr[c] = samples[c].data();
+    max_val_ptr[c] = max_val[c].data();
+    raw_pitch_ptr[c] = raw_pitch[c].data();
+    dywapitch_initdynamic(&trackers[c]);
+  }
+  std::vector<short> read_buf(hop_size * channels);
+  std::vector<int> hop_frames(batch_hops);
+
+  setvbuf(out, NULL, _IOFBF, 1 << 16);
+
+  const double start_time = GetMonotonicTime();
+  long total_frames = 0;
+  bool eof = false;
+  if (channels == 1) {
+    fprintf(out, "# time_s\tfreq_hz\tnote\tcent\n");
+  } else {
+    fprintf(out, "# time_s");
+    for (int c = 1; c <= channels; ++c) {
+      fprintf(out, "\tfreq_hz_%d\tnote_%d\tcent_%d", c, c, c);
+    }
+    fprintf(out, "\n");
+  }
+  while (!eof) {
+    int hops = 0;
+    while (hops < batch_hops) {
+      const int got = in->Read(read_buf.data(), hop_size);
+      if (got <= 0) {
+        eof = true;
+        break;
+      }
+      for (int c = 0; c < channels; ++c) {
+        short *hop = samples[c].data() + history + hops * hop_size;
+        for (int i = 0; i < got; ++i) {
+          hop[i] = read_buf[i * channels + c];
+        }
+        // Zero-pad a partial hop at the end of the file.
+        memset(hop + got, 0, (hop_size - got) * sizeof(short));
+      }
+      hop_frames[hops++] = got;
+    }
+    if (hops == 0)
+      break;
+
+    analyzer.Analyze(samples_ptr.data(), channels, hops,
+                     max_val_ptr.data(), raw_pitch_ptr.data());
+
+    for (int h = 0; h < hops; ++h) {
+      total_frames += hop_frames[h];
+      fprintf(out, "%.3f", 1.0 * total_frames / in->sample_rate());
+      for (int c = 0; c < channels; ++c) {
+        double freq = 0.0;
+        if (max_val[c][h] > PitchAnalyzer::kMinLoudness) {
+          freq = dywapitch_dynamicprocess(&trackers[c], raw_pitch[c][h]);
+        }
+        PrintPitch(out, freq);
+      }
+      fprintf(out, "\n");
+    }
+
+    // The end of this batch is the history of the next.
+    for (int c = 0; c < channels; ++c) {
+      memmove(samples[c].data(), samples[c].data() + hops * hop_size,
+              history * sizeof(short));
+    }
+  }
+  fflush(out);
+  const double duration = GetMonotonicTime() - start_time;
+  for (int c = 0; c < channels; ++c) {
+    dywapitch_delete(&trackers[c]);
+  }
+
+  const double audio_seconds = 1.0 * total_frames / in->sample_rate();
+  fprintf(stderr, "Analyzed %.1fs of audio in %.2fs with %d thread%s "
+          "(%.1fx realtime)\n", audio_seconds, duration,
+          threads, threads == 1 ? "" : "s",
+          duration > 0 ? audio_seconds / duration : 0.0);
+  return !ferror(out);
+}
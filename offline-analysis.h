@@ -0,0 +1,21 @@
+#ifndef PITCH_HERO_OFFLINE_ANALYSIS_H
+#define PITCH_HERO_OFFLINE_ANALYSIS_H
+
+#include <stdio.h>
+
+#include "dywapitchtrack.h"
+
+class AudioFile;
+
+// Run the pitch analysis over the whole file as fast as the CPU allows
+// and write one line per hop to "out": time, frequency, note and cent.
+// Each channel of a multi-channel file is analyzed on its own; the line
+// then has frequency, note and cent for each channel.
+// The pitch detection of independent hops is spread over "threads"
+// threads; the output is identical to a single threaded run.
+// "engine" and "precision" choose the pitch detector, see PitchDetector.
+// Throughput is reported on stderr. Returns false on error.
+bool RunOfflineAnalysis(AudioFile *in, int threads, const char *engine,
+                        dywapitch_precision precision, FILE *out);
+
+#endif  // PITCH_HERO_OFFLINE_ANALYSIS_H
@@ -0,0 +1,252 @@
+#include "pitch-analyzer.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "latency-histogram.h"
+#include "pitch-detector.h"
+
+// Hops of slack between capture and analysis before we drop samples.
+static const int kBufferedHops = 16;
+
+// The adaptive window does not shrink below this many samples.
+static const int kMinAnalyzedSamples = 256;
+
+// Even with the refined positions, fewer samples are too coarse for the
+// lowest notes: at 8 kHz, 512 of them read steady notes up to 40 cent off.
+static const int kMinWindowSize = 1024;
+
+// Confirming the pitch looks at two periods, but at least this many
+// samples, and needs at least this normalized autocorrelation. The period
+// is looked for within kConfirmLagRange samples of the tracked one.
+static const int kMinConfirmSamples = 256;
+static const double kMinConfirmCorrelation = 0.9;
+static const int kConfirmLagRange = 2;
+
+// The full analysis runs after this many confirmed hops in a row, or if
+// the level changed more than this factor since the last one.
+static const int kMaxConfirmedHops = 8;
+static const int kMaxLevelChange = 2;
+
+PitchAnalyzer::PitchAnalyzer(int window_size, int hop_size, int sample_rate)
+  : window_size_(window_size), hop_size_(hop_size), sample_rate_(sample_rate),
+    precision_(DYWAPITCH_DOUBLE), current_(0), adaptive_(true), confirm_(true), confirmed_hops_(0),
+    analyzed_peak_(0), analyzed_pitch_(0),
+    window_(SampleRing<short>::Create(window_size + kBufferedHops * hop_size)),
+    have_window_(false), hops_written_(0), hops_read_(0),
+    analyzed_samples_(0), processing_latency_(0), detector_nanos_(0),
+    dynamic_nanos_(0), levels_used_(0), confidence_(0) {
+  if (window_ == NULL) {
+    fprintf(stderr, "Can't allocate sample window.\n");
+    abort();
+  }
+  // Start out with silence, so that the first hop completes a window.
+  const int history = window_size_ - hop_size_;
+  memset(window_->WritePointer(), 0, sizeof(short) * history);
+  window_->CommitWrite(history);
+  // Hop n is the newest of the window after n slides.
+  hop_times_.resize(window_->capacity() / hop_size_ + 1);
+  dywapitch_initdynamic(&tracking_);
+  for (int k = 0; k < kWindowSizes; ++k) {
+    detectors_[k] = NULL;
+    slid_since_pitch_[k] = 0;
+  }
+  set_detector(PitchDetector::kEngines[0]);
+}
+
+PitchAnalyzer::~PitchAnalyzer() {
+  for (int k = 0; k < kWindowSizes; ++k)
+    delete detectors_[k];
+  dywapitch_delete(&tracking_);
+  delete window_;
+}
+
+bool PitchAnalyzer::set_detector(const char *engine) {
+  PitchDetector *detectors[kWindowSizes];
+  for (int k = 0; k < kWindowSizes; ++k) {
+    detectors[k] = PitchDetector::Create(engine, window_size_ >> k,
+                                         sample_rate_);
+    if (detectors[k] == NULL)
+      return false;   // Nothing created for an unknown engine.
+  }
+  for (int k = 0; k < kWindowSizes; ++k) {
+    delete detectors_[k];
+    detectors_[k] = detectors[k];
+    detectors_[k]->set_precision(precision_);
+    slid_since_pitch_[k] = 0;
+  }
+  return true;
+}
+
+void PitchAnalyzer::set_precision(dywapitch_precision precision) {
+  precision_ = precision;
+  for (int k = 0; k < kWindowSizes; ++k)
+    detectors_[k]->set_precision(precision);
+}
+
+bool PitchAnalyzer::AddSamples(const short *samples) {
+  short *const write_pos = HopToFill();
+  if (write_pos == NULL)
+    return false;
+  memcpy(write_pos, samples, sizeof(short) * hop_size_);
+  HopFilled();
+  return true;
+}
+
+short *PitchAnalyzer::HopToFill() {
+  if (window_->WriteSpace() < hop_size_)
+    return NULL;
+  return window_->WritePointer();
+}
+
+void PitchAnalyzer::HopFilled() {
+  // Published to the analysis thread with the samples.
+  hop_times_[hops_written_ % hop_times_.size()] = MonotonicNanos();
+  ++hops_written_;
+  window_->CommitWrite(hop_size_);
+}
+
+bool PitchAnalyzer::NextWindow() {
+  if (have_window_) {
+    window_->CommitRead(hop_size_);
+    ++hops_read_;
+    have_window_ = false;
+    // Beyond a window, there is nothing left to reuse anyway.
+    for (int k = 0; k < kWindowSizes; ++k) {
+      if (slid_since_pitch_[k] <= window_size_)
+        slid_since_pitch_[k] += hop_size_;
+    }
+  }
+  have_window_ = (window_->ReadAvailable() >= window_size_);
+  return have_window_;
+}
+
+int PitchAnalyzer::PeakOfNewestHop() const {
+  const short *hop = window_->ReadPointer() + window_size_ - hop_size_;
+  int max_val = 0;
+  for (int i = 0; i < hop_size_; ++i) {
+    if (abs(hop[i]) > max_val)
+      max_val = abs(hop[i]);
+  }
+  return max_val;
+}
+
+void PitchAnalyzer::SizesForRate(int sample_rate,
+                                 int *window_size, int *hop_size) {
+  // With the period refined to a fraction of a sample, the few periods of
+  // the lowest note the wavelet analysis needs are enough for a stable
+  // cent reading. The hop stays at 512 samples at 44.1kHz as before, so
+  // statistics count the same number of hops per second.
+  *window_size = std::max(kMinWindowSize,
+                          dywapitch_neededsamplecount(60, sample_rate));
+  *hop_size = *window_size / 8;
+}
+
+int PitchAnalyzer::ChooseWindow() {
+  const double trusted = dywapitch_trustedpitch(&tracking_);
+  if (!adaptive_ || trusted <= 0)
+    return 0;
+  // Leave room for an octave below, so that the dynamic tracking can still
+  // correct octave errors and notice the player going down.
+  const int needed = dywapitch_neededsamplecount(trusted / 2 > 1 ? trusted / 2 : 1,
+                                                 sample_rate_);
+  int k = 0;
+  while (k + 1 < kWindowSizes && (window_size_ >> (k + 1)) >= needed
+         && (window_size_ >> (k + 1)) >= kMinAnalyzedSamples)
+    ++k;
+  return k;
+}
+
+double PitchAnalyzer::ConfirmPitch(double pitch) {
+  const int lag = (int) round(sample_rate_ / pitch);
+  const int length = std::max(2 * lag, kMinConfirmSamples);
+  const int needed = length + lag + kConfirmLagRange;
+  if (lag <= kConfirmLagRange || needed > window_size_)
+    return 0.0;
+  // Correlate the oldest "length" of the newest "needed" samples with
+  // themselves one period (give or take a few samples) later.
+  const int kLags = 2 * kConfirmLagRange + 1;
+  const short *x = window_->ReadPointer() + window_size_ - needed;
+  const short *shifted = x + lag - kConfirmLagRange;
+  // A note an octave up correlates at the period as well; it shows at
+  // half the period.
+  const short *half = x + lag / 2;
+  int64_t energy = 0, half_corr = 0, half_energy = 0;
+  int64_t corr[kLags] = {0}, shifted_energy[kLags] = {0};
+  for (int i = 0; i < length; ++i) {
+    const int v = x[i];
+    energy += v * v;
+    for (int d = 0; d < kLags; ++d) {
+      const int w = shifted[i + d];
+      corr[d] += v * w;
+      shifted_energy[d] += w * w;
+    }
+    half_corr += v * half[i];
+    half_energy += half[i] * half[i];
+  }
+  if (half_energy == 0
+      || half_corr / sqrt((double) energy * half_energy)
+      >= kMinConfirmCorrelation)
+    return 0.0;
+  double r[kLags];
+  int best = 0;
+  for (int d = 0; d < kLags; ++d) {
+    if (energy == 0 || shifted_energy[d] == 0)
+      return 0.0;
+    r[d] = corr[d] / sqrt((double) energy * shifted_energy[d]);
+    if (r[d] > r[best]) best = d;
+  }
+  // Not periodic there, or the period moved too far to be sure.
+  if (r[best] < kMinConfirmCorrelation || best == 0 || best == kLags - 1)
+    return 0.0;
+  analyzed_samples_ = needed;
+  // Vertex of the parabola through the best correlation and its
+  // neighbours.
+  const double curvature = r[best - 1] - 2 * r[best] + r[best + 1];
+  const double offset = curvature < 0
+    ? 0.5 * (r[best - 1] - r[best + 1]) / curvature : 0;
+  return sample_rate_ / (lag - kConfirmLagRange + best + offset);
+}
+
+double PitchAnalyzer::ComputePitch() {
+  const int64_t start = MonotonicNanos();
+  const int peak = PeakOfNewestHop();
+  double raw = 0.0;
+  if (confirm_ && confirmed_hops_ < kMaxConfirmedHops
+      && peak * kMaxLevelChange >= analyzed_peak_
+      && peak <= analyzed_peak_ * kMaxLevelChange) {
+    // Only worth a try if the detector found the same pitch the tracking
+    // trusts, not e.g. one an octave off.
+    const double trusted = dywapitch_trustedpitch(&tracking_);
+    if (trusted > 0 && fabs(analyzed_pitch_ - trusted) < 0.03 * trusted)
+      raw = ConfirmPitch(trusted);
+  }
+  if (raw > 0) {
+    ++confirmed_hops_;
+    levels_used_ = 0;
+  } else {
+    confirmed_hops_ = 0;
+    analyzed_peak_ = peak;
+    const int k = current_;
+    analyzed_samples_ = window_size_ >> k;
+    const short *newest =
+      window_->ReadPointer() + window_size_ - analyzed_samples_;
+    raw = detectors_[k]->ComputePitch(newest, slid_since_pitch_[k]);
+    analyzed_pitch_ = raw;
+    slid_since_pitch_[k] = 0;
+    levels_used_ = detectors_[k]->levels_used();
+  }
+  const int64_t detector_done = MonotonicNanos();
+  const double pitch = dywapitch_dynamicprocess(&tracking_, raw);
+  confidence_ = dywapitch_confidence(&tracking_);
+  current_ = ChooseWindow();
+  const int64_t now = MonotonicNanos();
+  detector_nanos_ = detector_done - start;
+  dynamic_nanos_ = now - detector_done;
+  processing_latency_ = (now - hop_times_[hops_read_ % hop_times_.size()]) / 1e9;
+  return pitch;
+}
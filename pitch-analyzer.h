@@ -0,0 +1,150 @@
+#ifndef PITCH_HERO_PITCH_ANALYZER_H
+#define PITCH_HERO_PITCH_ANALYZER_H
+
+#include <stdint.h>
+
+#include <vector>
+
+#include "dywapitchtrack.h"
+#include "sample-ring.h"
+
+class PitchDetector;
+
+// Keeps a sliding window of the most recent samples and runs a pitch
+// detector and the dynamic tracking on it. New samples arrive in hops of a fixed size.
+//
+// Samples are added by one thread (usually audio capture), while the
+// analysis happens in another; they are connected by a lock-free ring
+// buffer that can hold a few hops in addition to the window.
+//
+// The window is long enough for the lowest note. While a higher pitch is
+// tracked with confidence, only the newest part of the window is analyzed
+// that still has room for an octave below it; this lowers the latency.
+// Once the pitch is lost, the whole window is used again.
+//
+// While a note is held, most hops only confirm its pitch: if the newest
+// samples correlate well with themselves one period of the tracked pitch
+// earlier, that period, refined to a fraction of a sample, gives the pitch
+// without running the detector. The full analysis still runs every few
+// hops, and whenever the level jumps, as on a new note.
+class PitchAnalyzer {
+public:
+  // Only hops with a peak above this value are worth analyzing.
+  static const int kMinLoudness = 2000;
+
+  // Sample rates the window sizes are sensible for: below, the cello range
+  // is barely sampled; above, the windows get needlessly large.
+  static const int kMinSampleRate = 8000;
+  static const int kMaxSampleRate = 384000;
+
+  PitchAnalyzer(int window_size, int hop_size, int sample_rate);
+  ~PitchAnalyzer();
+
+  int window_size() const { return window_size_; }
+  int hop_size() const { return hop_size_; }
+  int sample_rate() const { return sample_rate_; }
+
+  // Engine of the pitch detector, one of PitchDetector::kEngines; the
+  // default is the first. Returns false if there is no such engine.
+  // Set this and the precision before starting the threads.
+  bool set_detector(const char *engine);
+
+  // Precision of the detector, if it has a choice.
+  void set_precision(dywapitch_precision precision);
+
+  // Adapt the analyzed part of the window to the tracked pitch (default).
+  // If false, the whole window is always analyzed.
+  void set_adaptive_window(bool adaptive) { adaptive_ = adaptive; }
+
+  // Confirm a held pitch cheaply when possible (default). If false, the
+  // detector runs for every hop.
+  void set_confirm_pitch(bool confirm) { confirm_ = confirm; }
+
+  // -- Producer thread.
+  // Append the next hop_size() samples. Returns false if the analysis
+  // fell too far behind; the hop is dropped then.
+  bool AddSamples(const short *samples);
+
+  // The same without copying: returns where to put the next hop_size()
+  // samples, or NULL if the analysis fell too far behind. Call HopFilled()
+  // once they are written; the time of that call is taken as capture time.
+  short *HopToFill();
+  void HopFilled();
+
+  // -- Analysis thread.
+  // Slide the window to the next hop. Returns false if not enough samples
+  // have arrived yet.
+  bool NextWindow();
+
+  // Peak absolute value of the newest hop in the current window.
+  int PeakOfNewestHop() const;
+
+  // Compute the pitch of the current window in Hz; 0.0 if none found.
+  // Work done on the part of the window already seen in the previous
+  // call is reused.
+  double ComputePitch();
+
+  // Number of samples the last ComputePitch() looked at.
+  int analyzed_samples() const { return analyzed_samples_; }
+
+  // Seconds from the capture of the newest hop to the end of the last
+  // ComputePitch().
+  double processing_latency() const { return processing_latency_; }
+
+  // Time the last ComputePitch() spent in the detector (or in confirming
+  // the pitch) and in the dynamic tracking, and the wavelet levels it
+  // needed; 0 if the pitch was confirmed, -1 if the detector has none.
+  int64_t detector_nanos() const { return detector_nanos_; }
+  int64_t dynamic_nanos() const { return dynamic_nanos_; }
+  int levels_used() const { return levels_used_; }
+
+  // How sure the tracking is of the pitch after the last ComputePitch(),
+  // 0.0 to 1.0.
+  double confidence() const { return confidence_; }
+
+  // Window and hop size appropriate for cello range at "sample_rate".
+  static void SizesForRate(int sample_rate, int *window_size, int *hop_size);
+
+private:
+  // Analyzed sizes: window_size_ and kWindowSizes - 1 halvings of it.
+  static const int kWindowSizes = 4;
+
+  // Index of the smallest analyzed size that fits the tracked pitch.
+  int ChooseWindow();
+
+  // "pitch" refined by the autocorrelation of the newest samples, or 0.0
+  // if they don't confirm it.
+  double ConfirmPitch(double pitch);
+
+  const int window_size_;
+  const int hop_size_;
+  const int sample_rate_;
+  // One detector per analyzed size; detectors_[0] analyzes the whole
+  // window. "tracking_" only has the dynamic tracking state.
+  PitchDetector *detectors_[kWindowSizes];
+  dywapitchtracker tracking_;
+  dywapitch_precision precision_;
+  int slid_since_pitch_[kWindowSizes];  // Samples moved since last analysis.
+  int current_;          // Index of the size to analyze next.
+  bool adaptive_;
+  bool confirm_;
+  int confirmed_hops_;   // In a row, since the last full analysis.
+  int analyzed_peak_;    // Level at the last full analysis.
+  double analyzed_pitch_;   // Its raw pitch.
+  SampleRing<short> *const window_;   // Read position is start of window.
+  bool have_window_;
+
+  // Capture time of each hop in the ring, indexed by hop number.
+  std::vector<int64_t> hop_times_;
+  uint64_t hops_written_;    // Producer only.
+  uint64_t hops_read_;       // Analysis only.
+
+  int analyzed_samples_;
+  double processing_latency_;
+  int64_t detector_nanos_;
+  int64_t dynamic_nanos_;
+  int levels_used_;
+  double confidence_;
+};
+
+#endif  // PITCH_HERO_PITCH_ANALYZER_H
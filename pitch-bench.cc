@@ -0,0 +1,661 @@
+// Micro-benchmark of the pitch tracker on synthetic signals.
+//
+// Prints one tab separated line per measurement to stdout, so that runs
+// can be kept and compared over time:
+//   tracker : the dywapitch entry points alone, per window size.
+//   detector: each PitchDetector engine alone, per window size.
+//   live    : the PitchAnalyzer as the UI uses it, hop by hop, with each
+//             engine.
+//
+// With -a, measures accuracy instead, also on labeled recordings, and
+// exits with an error if any way to compute the pitch falls behind the
+// reference implementation.
+
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "dywapitchtrack.h"
+#include "pitch-analyzer.h"
+#include "pitch-detector.h"
+#include "synth-signal.h"
+
+// Each measurement is repeated; the fastest pass counts, as the others
+// only add noise from the rest of the system.
+static const int kPasses = 3;
+
+// Count allocations by interposing the glibc allocator; the analysis of
+// a hop should not need any.
+static std::atomic<long> s_allocations(0);
+
+extern "C" {
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t count, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc(size_t size) {
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+void *calloc(size_t count, size_t size) {
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+void *realloc(void *ptr, size_t size) {
+  s_allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+}
+
+static double GetMonotonicTime() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Ways to call the tracker.
+enum Variant {
+  VARIANT_DOUBLE,         // dywapitch_computepitch() on doubles.
+  VARIANT_S16,            // dywapitch_computepitch_s16(), each precision.
+  VARIANT_S16_FLOAT,
+  VARIANT_S16_FIXED,
+  VARIANT_INCREMENTAL,    // .. and keeping the levels from hop to hop.
+};
+static const char *const kVariantName[] = {
+  "double", "s16", "s16_float", "s16_fixed", "incremental",
+};
+static const int kVariantCount = sizeof(kVariantName) / sizeof(kVariantName[0]);
+
+// How the PitchAnalyzer is set up.
+enum LiveMode {
+  LIVE_FULL,              // Wavelet analysis of the whole window.
+  LIVE_ADAPTIVE,          // .. of the part the tracked pitch needs.
+  LIVE_CONFIRM,           // .. and confirming a held pitch in between.
+};
+static const char *const kLiveModeName[] = {
+  "full", "adaptive", "confirm",
+};
+static const int kLiveModeCount =
+  sizeof(kLiveModeName) / sizeof(kLiveModeName[0]);
+
+static void SetLiveMode(PitchAnalyzer *analyzer, int engine, LiveMode mode) {
+  analyzer->set_detector(PitchDetector::kEngines[engine]);
+  analyzer->set_adaptive_window(mode != LIVE_FULL);
+  analyzer->set_confirm_pitch(mode == LIVE_CONFIRM);
+}
+
+// The live modes of the default engine go by their plain name, e.g.
+// "confirm"; those of the others by engine and mode, e.g. "yin/confirm".
+static std::string LiveName(int engine, LiveMode mode) {
+  if (engine == 0)
+    return kLiveModeName[mode];
+  return std::string(PitchDetector::kEngines[engine]) + "/"
+    + kLiveModeName[mode];
+}
+
+struct Measurement {
+  int hops;
+  double seconds;     // Of the fastest pass.
+  long allocations;   // Over all passes.
+};
+
+static void PrintHeader(int sample_rate, double seconds) {
+  printf("# pitch-bench rate=%d seconds=%.1f passes=%d\n",
+         sample_rate, seconds, kPasses);
+  printf("# kind\tsignal\tvariant\twindow\thop\thops\tns_per_hop"
+         "\thops_per_s\tallocs_per_hop\tx_realtime\n");
+}
+
+static void PrintMeasurement(const char *kind, const SynthSignal &signal,
+                             const char *variant, int window, int hop,
+                             int sample_rate, const Measurement &m) {
+  const double per_hop = m.seconds / m.hops;
+  printf("%s\t%s\t%s\t%d\t%d\t%d\t%.0f\t%.0f\t%.3f\t%.1f\n",
+         kind, signal.name.c_str(), variant, window, hop, m.hops,
+         per_hop * 1e9, 1 / per_hop,
+         (double) m.allocations / (kPasses * m.hops),
+         (double) hop / sample_rate / per_hop);
+  fflush(stdout);
+}
+
+static Measurement MeasureTracker(const SynthSignal &signal, Variant variant,
+                                  int window, int hop, int sample_rate) {
+  const int count = signal.samples.size();
+  // The double API expects samples in [-1, 1].
+  std::vector<double> as_double(count);
+  for (int i = 0; i < count; ++i) as_double[i] = signal.samples[i] / 32768.0;
+
+  Measurement m;
+  m.hops = (count - window) / hop + 1;
+  m.seconds = 0;
+  m.allocations = 0;
+  for (int pass = 0; pass < kPasses; ++pass) {
+    dywapitchtracker tracker;
+    dywapitch_inittracking(&tracker, window, sample_rate);
+    if (variant == VARIANT_S16_FLOAT)
+      dywapitch_setprecision(&tracker, DYWAPITCH_FLOAT);
+    else if (variant == VARIANT_S16_FIXED)
+      dywapitch_setprecision(&tracker, DYWAPITCH_FIXED);
+
+    const long allocations_before = s_allocations.load();
+    const double start = GetMonotonicTime();
+    for (int h = 0; h < m.hops; ++h) {
+      const int pos = h * hop;
+      switch (variant) {
+      case VARIANT_DOUBLE:
+        dywapitch_computepitch(&tracker, &as_double[pos]);
+        break;
+      case VARIANT_S16: case VARIANT_S16_FLOAT: case VARIANT_S16_FIXED:
+        dywapitch_computepitch_s16(&tracker, &signal.samples[pos]);
+        break;
+      case VARIANT_INCREMENTAL:
+        dywapitch_computepitch_incremental_s16(&tracker, &signal.samples[pos],
+                                               h == 0 ? window : hop);
+        break;
+      }
+    }
+    const double elapsed = GetMonotonicTime() - start;
+    m.allocations += s_allocations.load() - allocations_before;
+    dywapitch_delete(&tracker);
+    if (pass == 0 || elapsed < m.seconds) m.seconds = elapsed;
+  }
+  return m;
+}
+
+static Measurement MeasureDetector(const SynthSignal &signal, int engine,
+                                   int window, int hop, int sample_rate) {
+  const int count = signal.samples.size();
+  Measurement m;
+  m.hops = (count - window) / hop + 1;
+  m.seconds = 0;
+  m.allocations = 0;
+  for (int pass = 0; pass < kPasses; ++pass) {
+    PitchDetector *detector = PitchDetector::Create(
+      PitchDetector::kEngines[engine], window, sample_rate);
+
+    const long allocations_before = s_allocations.load();
+    const double start = GetMonotonicTime();
+    for (int h = 0; h < m.hops; ++h) {
+      detector->ComputePitch(&signal.samples[h * hop], h == 0 ? 0 : hop);
+    }
+    const double elapsed = GetMonotonicTime() - start;
+    m.allocations += s_allocations.load() - allocations_before;
+    delete detector;
+    if (pass == 0 || elapsed < m.seconds) m.seconds = elapsed;
+  }
+  return m;
+}
+
+// Everything the analysis thread of the UI does per hop, from adding the
+// captured samples to the pitch.
+static Measurement MeasureLive(const SynthSignal &signal, int engine,
+                               LiveMode mode, int window, int hop,
+                               int sample_rate) {
+  const int count = signal.samples.size();
+  Measurement m;
+  m.hops = count / hop;
+  m.seconds = 0;
+  m.allocations = 0;
+  for (int pass = 0; pass < kPasses; ++pass) {
+    PitchAnalyzer analyzer(window, hop, sample_rate);
+    SetLiveMode(&analyzer, engine, mode);
+
+    const long allocations_before = s_allocations.load();
+    const double start = GetMonotonicTime();
+    for (int h = 0; h < m.hops; ++h) {
+      analyzer.AddSamples(&signal.samples[h * hop]);
+      while (analyzer.NextWindow()) {
+        if (analyzer.PeakOfNewestHop() > PitchAnalyzer::kMinLoudness)
+          analyzer.ComputePitch();
+      }
+    }
+    const double elapsed = GetMonotonicTime() - start;
+    m.allocations += s_allocations.load() - allocations_before;
+    if (pass == 0 || elapsed < m.seconds) m.seconds = elapsed;
+  }
+  return m;
+}
+
+// -- Accuracy.
+// Score the pitch per hop against the truth of the signal. Everything is
+// compared to dywapitch_computepitch() on doubles, the reference
+// implementation all others derive from.
+
+// Errors beyond this are gross, typically octave errors. 20% is the usual
+// threshold in the literature.
+static const double kGrossErrorCents = 1200 * 0.263;   // log2(1.2)
+// Variants that may round differently can be this much worse than the
+// reference before we fail.
+static const double kMaxExtraErrorPercent = 1.0;
+static const double kMaxExtraCents = 2.0;
+
+// The pitch of a hop, found in the last "analyzed" samples of the window.
+struct HopPitch {
+  double pitch;
+  int analyzed;
+};
+// Per hop, for windows ending at window + i * hop.
+typedef std::vector<HopPitch> PitchTrack;
+
+// How a variant scored on one signal.
+struct Score {
+  Score() : hops(0), voiced(0), unvoiced(0), gross(0), misses(0),
+            false_alarms(0), diverged(0) {}
+  int hops;
+  int voiced;         // Hops with a pitch in the truth,
+  int unvoiced;       // .. and without.
+  int gross;          // Voiced hops found with a gross error,
+  int misses;         // .. or none found.
+  int false_alarms;   // Unvoiced hops with a pitch found.
+  int diverged;       // Hops that differ from the reference.
+  std::vector<double> cents;   // Absolute error of non-gross hops.
+};
+
+// Like the analysis thread, quiet hops are not analyzed.
+static bool IsLoud(const SynthSignal &signal, int end, int hop) {
+  for (int i = end - hop; i < end; ++i) {
+    if (abs(signal.samples[i]) > PitchAnalyzer::kMinLoudness)
+      return true;
+  }
+  return false;
+}
+
+static PitchTrack TrackWithVariant(const SynthSignal &signal, Variant variant,
+                                   int window, int hop, int sample_rate) {
+  const int count = signal.samples.size();
+  std::vector<double> as_double(count);
+  for (int i = 0; i < count; ++i) as_double[i] = signal.samples[i] / 32768.0;
+
+  dywapitchtracker tracker;
+  dywapitch_inittracking(&tracker, window, sample_rate);
+  if (variant == VARIANT_S16_FLOAT)
+    dywapitch_setprecision(&tracker, DYWAPITCH_FLOAT);
+  else if (variant == VARIANT_S16_FIXED)
+    dywapitch_setprecision(&tracker, DYWAPITCH_FIXED);
+  PitchTrack result;
+  int advanced = window;   // Since the last analysis.
+  for (int pos = 0; pos + window <= count; pos += hop, advanced += hop) {
+    if (!IsLoud(signal, pos + window, hop)) {
+      result.push_back({0.0, window});
+      continue;
+    }
+    double pitch = 0;
+    switch (variant) {
+    case VARIANT_DOUBLE:
+      pitch = dywapitch_computepitch(&tracker, &as_double[pos]);
+      break;
+    case VARIANT_S16: case VARIANT_S16_FLOAT: case VARIANT_S16_FIXED:
+      pitch = dywapitch_computepitch_s16(&tracker, &signal.samples[pos]);
+      break;
+    case VARIANT_INCREMENTAL:
+      pitch = dywapitch_computepitch_incremental_s16(
+        &tracker, &signal.samples[pos], advanced > window ? window : advanced);
+      advanced = 0;
+      break;
+    }
+    result.push_back({pitch, window});
+  }
+  dywapitch_delete(&tracker);
+  return result;
+}
+
+// The incremental variant with each window following the previous one of
+// its tracker without overlap, as after a gap in the analysis: the hops
+// go round robin to window / hop trackers for the raw pitch, and one
+// tracks the pitch from them in order.
+static PitchTrack TrackIncrementalByWindow(const SynthSignal &signal,
+                                           int window, int hop,
+                                           int sample_rate) {
+  const int count = signal.samples.size();
+  const int rounds = window % hop == 0 ? window / hop : 1;
+  std::vector<dywapitchtracker> raw(rounds);
+  std::vector<int> last_pos(rounds, -1);
+  for (dywapitchtracker &t : raw) {
+    dywapitch_inittracking(&t, window, sample_rate);
+  }
+  dywapitchtracker tracker;
+  dywapitch_initdynamic(&tracker);
+  PitchTrack result;
+  for (int pos = 0, h = 0; pos + window <= count; pos += hop, ++h) {
+    if (!IsLoud(signal, pos + window, hop)) {
+      result.push_back({0.0, window});
+      continue;
+    }
+    const int r = h % rounds;
+    const int advanced = last_pos[r] >= 0 && pos - last_pos[r] == window
+      ? window : 0;
+    last_pos[r] = pos;
+    const double pitch = dywapitch_computerawpitch_incremental_s16(
+      &raw[r], &signal.samples[pos], advanced);
+    result.push_back({dywapitch_dynamicprocess(&tracker, pitch), window});
+  }
+  for (dywapitchtracker &t : raw) dywapitch_delete(&t);
+  dywapitch_delete(&tracker);
+  return result;
+}
+
+static PitchTrack TrackLive(const SynthSignal &signal, int engine,
+                            LiveMode mode, int window, int hop,
+                            int sample_rate) {
+  PitchAnalyzer analyzer(window, hop, sample_rate);
+  SetLiveMode(&analyzer, engine, mode);
+  PitchTrack result;
+  const int hops = signal.samples.size() / hop;
+  for (int h = 0; h < hops; ++h) {
+    analyzer.AddSamples(&signal.samples[h * hop]);
+    while (analyzer.NextWindow()) {
+      HopPitch p = {0.0, window};
+      if (analyzer.PeakOfNewestHop() > PitchAnalyzer::kMinLoudness) {
+        p.pitch = analyzer.ComputePitch();
+        p.analyzed = analyzer.analyzed_samples();
+      }
+      // The first windows start with the silence the analyzer is primed
+      // with; they are dropped from the reference as well.
+      if ((h + 1) * hop >= window)
+        result.push_back(p);
+    }
+  }
+  return result;
+}
+
+// The true pitch of samples [begin, end): 0.0 if unvoiced, their mean if
+// voiced and within a semitone, -1 if mixed and not worth scoring.
+static double TruePitch(const SynthSignal &signal, int begin, int end) {
+  double sum = 0, lowest = 1e9, highest = 0;
+  for (int i = begin; i < end; ++i) {
+    const double f = signal.freq[i];
+    sum += f;
+    if (f < lowest) lowest = f;
+    if (f > highest) highest = f;
+  }
+  if (highest == 0)
+    return 0.0;
+  if (lowest == 0 || highest / lowest > 1.0595)
+    return -1;
+  return sum / (end - begin);
+}
+
+static double Cents(double f, double reference) {
+  return 1200 * log2(f / reference);
+}
+
+static Score ScoreTrack(const SynthSignal &signal, const PitchTrack &track,
+                        const PitchTrack &reference, int window, int hop) {
+  Score score;
+  for (size_t i = 0; i < track.size() && i < reference.size(); ++i) {
+    const double f = track[i].pitch;
+    const double ref = reference[i].pitch;
+    score.hops++;
+    if ((f == 0) != (ref == 0) || (f != 0 && fabs(Cents(f, ref)) > 1))
+      score.diverged++;
+
+    const int end = window + i * hop;
+    // The same hops are scored for all, but the truth is of the part of
+    // the window that was analyzed.
+    if (TruePitch(signal, end - window, end) < 0)
+      continue;
+    const double truth = TruePitch(signal, end - track[i].analyzed, end);
+    if (truth == 0) {
+      score.unvoiced++;
+      if (f > 0) score.false_alarms++;
+      continue;
+    }
+    score.voiced++;
+    if (f == 0) {
+      score.misses++;
+    } else if (fabs(Cents(f, truth)) > kGrossErrorCents) {
+      score.gross++;
+    } else {
+      score.cents.push_back(fabs(Cents(f, truth)));
+    }
+  }
+  std::sort(score.cents.begin(), score.cents.end());
+  return score;
+}
+
+static double Percent(int count, int total) {
+  return total > 0 ? 100.0 * count / total : 0.0;
+}
+
+static double Percentile(const std::vector<double> &sorted, double p) {
+  if (sorted.empty()) return 0.0;
+  return sorted[(size_t) (p / 100 * (sorted.size() - 1))];
+}
+
+static double Mean(const std::vector<double> &v) {
+  double sum = 0;
+  for (double x : v) sum += x;
+  return v.empty() ? 0.0 : sum / v.size();
+}
+
+// What a variant has to achieve compared to the reference.
+enum Check {
+  CHECK_EXACT,       // The same pitch for every hop.
+  CHECK_ACCURACY,    // At most a little less accurate.
+  CHECK_NONE,        // Only reported; a different method, not a kernel.
+};
+
+// Returns false if "score" is unacceptable compared to "reference".
+static bool CheckScore(const Score &score, const Score &reference,
+                       Check check) {
+  if (check == CHECK_NONE)
+    return true;
+  if (check == CHECK_EXACT)
+    return score.diverged == 0;
+  const int voiced = reference.voiced;
+  if (Percent(score.gross, voiced) > Percent(reference.gross, voiced)
+      + kMaxExtraErrorPercent)
+    return false;
+  if (Percent(score.misses, voiced) > Percent(reference.misses, voiced)
+      + kMaxExtraErrorPercent)
+    return false;
+  if (Percent(score.false_alarms, reference.unvoiced)
+      > Percent(reference.false_alarms, reference.unvoiced)
+      + kMaxExtraErrorPercent)
+    return false;
+  return Percentile(score.cents, 95)
+    <= Percentile(reference.cents, 95) + kMaxExtraCents;
+}
+
+static bool PrintScore(const SynthSignal &signal, const char *variant,
+                       const Score &score, const Score &reference,
+                       Check check) {
+  const bool ok = CheckScore(score, reference, check);
+  printf("accuracy\t%s\t%s\t%d\t%d\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f\t%.2f"
+         "\t%.2f\t%s\n", signal.name.c_str(), variant,
+         score.voiced, score.unvoiced,
+         Percent(score.gross, score.voiced), Mean(score.cents),
+         Percentile(score.cents, 50), Percentile(score.cents, 95),
+         Percent(score.misses, score.voiced),
+         Percent(score.false_alarms, score.unvoiced),
+         Percent(score.diverged, score.hops),
+         check == CHECK_NONE ? "-" : (ok ? "ok" : "FAIL"));
+  fflush(stdout);
+  if (!ok) {
+    fprintf(stderr, "%s: %s %s the reference.\n", signal.name.c_str(), variant,
+            check == CHECK_EXACT ? "differs from" : "is less accurate than");
+  }
+  return ok;
+}
+
+// "signal" after "samples" of silence, like the analyzer is primed with.
+static SynthSignal WithLeadingSilence(const SynthSignal &signal,
+                                      int samples) {
+  SynthSignal result;
+  result.name = signal.name;
+  result.samples.assign(samples, 0);
+  result.samples.insert(result.samples.end(), signal.samples.begin(),
+                        signal.samples.end());
+  result.freq.assign(samples, 0.0f);
+  result.freq.insert(result.freq.end(), signal.freq.begin(),
+                     signal.freq.end());
+  return result;
+}
+
+// Drops the results of the windows that start in "silence" samples added
+// in front; the rest is per hop of the signal without them.
+static PitchTrack WithoutLeadingSilence(PitchTrack track, int silence,
+                                        int hop) {
+  track.erase(track.begin(), track.begin() + std::min<size_t>(
+                silence / hop, track.size()));
+  return track;
+}
+
+// Returns false if any variant fails.
+static bool RunAccuracy(const std::vector<SynthSignal> &signals,
+                        int window, int hop, int sample_rate) {
+  printf("# kind\tsignal\tvariant\tvoiced\tunvoiced\tgross_pct\tcent_mean"
+         "\tcent_p50\tcent_p95\tmiss_pct\tfalse_alarm_pct\tdiverged_pct"
+         "\tstatus\n");
+  bool all_ok = true;
+  // The analyzer starts out with a window of silence but for a hop, and
+  // the dynamic tracking of its results already sees the windows that
+  // start in there. So do the others, to compute the same.
+  const int silence = window - hop;
+  for (const SynthSignal &signal : signals) {
+    const SynthSignal primed = WithLeadingSilence(signal, silence);
+    const PitchTrack reference = WithoutLeadingSilence(
+      TrackWithVariant(primed, VARIANT_DOUBLE, window, hop, sample_rate),
+      silence, hop);
+    const Score reference_score = ScoreTrack(signal, reference, reference,
+                                             window, hop);
+    for (int v = 0; v < kVariantCount; ++v) {
+      const PitchTrack track = WithoutLeadingSilence(
+        TrackWithVariant(primed, (Variant) v, window, hop, sample_rate),
+        silence, hop);
+      // Only float and fixed point may round differently.
+      const Check check = (v == VARIANT_S16_FLOAT || v == VARIANT_S16_FIXED)
+        ? CHECK_ACCURACY : CHECK_EXACT;
+      all_ok &= PrintScore(signal, kVariantName[v],
+                           ScoreTrack(signal, track, reference, window, hop),
+                           reference_score, check);
+    }
+    all_ok &= PrintScore(signal, "incremental_window",
+                         ScoreTrack(signal, WithoutLeadingSilence(
+                                      TrackIncrementalByWindow(
+                                        primed, window, hop, sample_rate),
+                                      silence, hop),
+                                    reference, window, hop),
+                         reference_score, CHECK_EXACT);
+    // The analysis thread with the wavelet detector on the full window
+    // computes the same as the reference. The adaptive window looks at
+    // other samples, the other engines are other methods; how they
+    // compare is for the reader to judge.
+    for (int engine = 0; engine < PitchDetector::kEngineCount; ++engine) {
+      for (int mode = 0; mode < kLiveModeCount; ++mode) {
+        const PitchTrack track = TrackLive(signal, engine, (LiveMode) mode,
+                                           window, hop, sample_rate);
+        const bool exact = (engine == 0 && mode == LIVE_FULL);
+        all_ok &= PrintScore(signal, LiveName(engine, (LiveMode) mode).c_str(),
+                             ScoreTrack(signal, track, reference, window, hop),
+                             reference_score,
+                             exact ? CHECK_EXACT : CHECK_NONE);
+      }
+    }
+  }
+  return all_ok;
+}
+
+static int usage(const char *progname) {
+  fprintf(stderr, "usage: %s [options] [<recording> <labels>]...\n",
+          progname);
+  fprintf(stderr, "Options:\n"
+          "\t-r <rate>  : Sample rate of the signals (default 44100).\n"
+          "\t-t <sec>   : Length of each signal in seconds (default 10).\n"
+          "\t-a         : Measure accuracy instead of speed, on the "
+          "synthetic\n"
+          "\t             signals and the given labeled recordings.\n");
+  return 1;
+}
+
+int main(int argc, char *argv[]) {
+  int sample_rate = 44100;
+  double seconds = 10;
+  bool accuracy = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "r:t:a")) != -1) {
+    switch (opt) {
+    case 'r': sample_rate = atoi(optarg); break;
+    case 't': seconds = atof(optarg); break;
+    case 'a': accuracy = true; break;
+    default:
+      return usage(argv[0]);
+    }
+  }
+  if (sample_rate < PitchAnalyzer::kMinSampleRate
+      || sample_rate > PitchAnalyzer::kMaxSampleRate) {
+    fprintf(stderr, "Sample rate needs to be between %d and %d.\n",
+            PitchAnalyzer::kMinSampleRate, PitchAnalyzer::kMaxSampleRate);
+    return usage(argv[0]);
+  }
+
+  int window_size, hop_size;
+  PitchAnalyzer::SizesForRate(sample_rate, &window_size, &hop_size);
+  if (seconds * sample_rate < window_size) {
+    fprintf(stderr, "Signals need to be at least one window long.\n");
+    return usage(argv[0]);
+  }
+
+  if ((argc - optind) % 2 != 0 || (!accuracy && argc > optind)) {
+    return usage(argv[0]);
+  }
+
+  const double start = GetMonotonicTime();
+  std::vector<SynthSignal> signals = MakeSynthSignals(sample_rate, seconds);
+  if (accuracy) {
+    for (int i = optind; i < argc; i += 2) {
+      SynthSignal recording;
+      if (!ReadLabeledRecording(argv[i], argv[i + 1], sample_rate, &recording))
+        return 1;
+      if ((int) recording.samples.size() < window_size) {
+        fprintf(stderr, "%s: shorter than a window.\n", argv[i]);
+        return 1;
+      }
+      signals.push_back(recording);
+    }
+    const bool ok = RunAccuracy(signals, window_size, hop_size, sample_rate);
+    fprintf(stderr, "Accuracy check took %.1fs%s.\n",
+            GetMonotonicTime() - start, ok ? "" : "; FAILED");
+    return ok ? 0 : 1;
+  }
+
+  PrintHeader(sample_rate, seconds);
+  for (const SynthSignal &signal : signals) {
+    // The window of the UI and the smaller ones it adapts to.
+    for (int window = window_size; window >= window_size / 8; window /= 2) {
+      for (int v = 0; v < kVariantCount; ++v) {
+        const Measurement m = MeasureTracker(signal, (Variant) v, window,
+                                             window / 16, sample_rate);
+        PrintMeasurement("tracker", signal, kVariantName[v], window,
+                         window / 16, sample_rate, m);
+      }
+    }
+    for (int window = window_size; window >= window_size / 8; window /= 2) {
+      for (int engine = 0; engine < PitchDetector::kEngineCount; ++engine) {
+        const Measurement m = MeasureDetector(signal, engine, window,
+                                              window / 16, sample_rate);
+        PrintMeasurement("detector", signal, PitchDetector::kEngines[engine],
+                         window, window / 16, sample_rate, m);
+      }
+    }
+    for (int engine = 0; engine < PitchDetector::kEngineCount; ++engine) {
+      for (int mode = 0; mode < kLiveModeCount; ++mode) {
+        const Measurement m = MeasureLive(signal, engine, (LiveMode) mode,
+                                          window_size, hop_size, sample_rate);
+        PrintMeasurement("live", signal,
+                         LiveName(engine, (LiveMode) mode).c_str(),
+                         window_size, hop_size, sample_rate, m);
+      }
+    }
+  }
+  fprintf(stderr, "Benchmark took %.1fs.\n", GetMonotonicTime() - start);
+  return 0;
+}
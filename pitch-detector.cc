@@ -0,0 +1,237 @@
+#include "pitch-detector.h"
+
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "fft.h"
+
+const char *const PitchDetector::kEngines[kEngineCount] = {
+  "wavelet", "yin", "mpm",
+};
+
+// Like the wavelet algorithm, don't look for pitches above this.
+static const double kMaxPitch = 3000.0;
+
+// YIN takes the first dip of the normalized difference below this.
+static const double kYinThreshold = 0.15;
+
+// MPM takes the first peak of the normalized square difference that
+// reaches this fraction of the highest, if that is at least kMpmMinClarity.
+static const double kMpmCutoff = 0.9;
+static const double kMpmMinClarity = 0.6;
+
+// Offset of the vertex of the parabola through (-1, a), (0, b), (1, c).
+static double ParabolaVertex(double a, double b, double c) {
+  const double curvature = a - 2 * b + c;
+  return curvature != 0 ? 0.5 * (a - c) / curvature : 0.0;
+}
+
+namespace {
+class WaveletDetector : public PitchDetector {
+public:
+  WaveletDetector(int window_size, int sample_rate) {
+    dywapitch_inittracking(&tracker_, window_size, sample_rate);
+  }
+  ~WaveletDetector() { dywapitch_delete(&tracker_); }
+
+  const char *name() const { return "wavelet"; }
+
+  void set_precision(dywapitch_precision precision) {
+    dywapitch_setprecision(&tracker_, precision);
+  }
+
+  double ComputePitch(const short *samples, int advanced) {
+    return dywapitch_computerawpitch_incremental_s16(&tracker_, samples,
+                                                     advanced);
+  }
+
+  int levels_used() const {
+    return dywapitch_levelsused(const_cast<dywapitchtracker*>(&tracker_));
+  }
+
+private:
+  dywapitchtracker tracker_;   // Only its scratch buffers are used.
+};
+
+// Common to the detectors that look for the period among the lags up to
+// half the window, i.e. for at least two periods in the window.
+class LagDetector : public PitchDetector {
+protected:
+  LagDetector(int window_size, int sample_rate)
+    : window_size_(window_size), sample_rate_(sample_rate),
+      min_lag_(std::max(2, (int) (sample_rate / kMaxPitch))),
+      max_lag_(window_size / 2),
+      fft_(Fft::SizeFor(2 * window_size)), spectrum_(fft_.size()) {}
+
+  const int window_size_;
+  const int sample_rate_;
+  const int min_lag_;
+  const int max_lag_;
+  const Fft fft_;
+  // Large enough to not wrap around: correlations at negative lags end
+  // up beyond the window.
+  std::vector<Fft::Complex> spectrum_;
+};
+
+// YIN, after de Cheveigné and Kawahara, "YIN, a fundamental frequency
+// estimator for speech and music" (2002).
+//
+// The difference of the newest half of the window to the window shifted
+// back by each lag, d(lag) = sum (x[j] - x[j - lag])^2 over j in the
+// newest half, is the energy of both minus twice their cross correlation.
+// The cross correlation for all lags takes one transform of the half and
+// the window packed into one complex signal, and one back. The window is
+// reversed for that, so the newest half comes first.
+class YinDetector : public LagDetector {
+public:
+  YinDetector(int window_size, int sample_rate)
+    : LagDetector(window_size, sample_rate), energy_(window_size + 1),
+      difference_(max_lag_ + 1) {}
+
+  const char *name() const { return "yin"; }
+
+  double ComputePitch(const short *samples, int) {
+    const int size = fft_.size();
+    const int half = max_lag_;
+    // The newest half in the real part, the whole window in the imaginary.
+    const short *newest = samples + window_size_ - 1;
+    for (int i = 0; i < window_size_; ++i) {
+      spectrum_[i] = Fft::Complex(i < half ? newest[-i] : 0, newest[-i]);
+    }
+    memset((void*) &spectrum_[window_size_], 0,
+           (size - window_size_) * sizeof(Fft::Complex));
+    fft_.Forward(spectrum_.data());
+    // Unpack the transforms of both, A and B, and multiply conj(A) * B
+    // for the cross correlation. Bins k and size - k depend on each other.
+    for (int k = 0; k <= size / 2; ++k) {
+      const Fft::Complex z = spectrum_[k];
+      const Fft::Complex mirror = std::conj(spectrum_[(size - k) % size]);
+      const Fft::Complex a = 0.5 * (z + mirror);
+      const Fft::Complex b = Fft::Complex(0, -0.5) * (z - mirror);
+      spectrum_[k] = std::conj(a) * b;
+      // Of the mirrored bin, both are the conjugates.
+      if (k != 0 && k != size - k)
+        spectrum_[size - k] = a * std::conj(b);
+    }
+    fft_.Inverse(spectrum_.data());
+
+    energy_[0] = 0;
+    for (int i = 0; i < window_size_; ++i) {
+      energy_[i + 1] = energy_[i] + (double) newest[-i] * newest[-i];
+    }
+    // The difference normalized by its mean up to each lag.
+    difference_[0] = 1.0;
+    double sum = 0;
+    for (int lag = 1; lag <= max_lag_; ++lag) {
+      const double correlation = spectrum_[lag].real() / size;
+      const double d = energy_[half] + energy_[lag + half] - energy_[lag]
+        - 2 * correlation;
+      sum += d;
+      difference_[lag] = sum > 0 ? d * lag / sum : 1.0;
+    }
+    for (int lag = min_lag_; lag < max_lag_; ++lag) {
+      if (difference_[lag] >= kYinThreshold)
+        continue;
+      while (lag + 1 < max_lag_ && difference_[lag + 1] < difference_[lag])
+        ++lag;
+      const double offset = ParabolaVertex(difference_[lag - 1],
+                                           difference_[lag],
+                                           difference_[lag + 1]);
+      return sample_rate_ / (lag + offset);
+    }
+    return 0.0;
+  }
+
+private:
+  std::vector<double> energy_;       // Of the newest samples up to each.
+  std::vector<double> difference_;   // Per lag, normalized.
+};
+
+// The McLeod pitch method, after McLeod and Wyvill, "A smarter way to
+// find pitch" (2005).
+//
+// The normalized square difference n(lag) = 2 r(lag) / m(lag) of the
+// autocorrelation r and the energy m of the overlapping parts is 1.0 for
+// a perfectly periodic window. The autocorrelation of all lags takes a
+// transform of the window and one back.
+class MpmDetector : public LagDetector {
+public:
+  MpmDetector(int window_size, int sample_rate)
+    : LagDetector(window_size, sample_rate), nsdf_(max_lag_ + 1) {
+    peaks_.reserve(max_lag_);
+  }
+
+  const char *name() const { return "mpm"; }
+
+  double ComputePitch(const short *samples, int) {
+    const int size = fft_.size();
+    double m = 0;
+    for (int i = 0; i < window_size_; ++i) {
+      spectrum_[i] = Fft::Complex(samples[i], 0);
+      m += 2.0 * samples[i] * samples[i];
+    }
+    memset((void*) &spectrum_[window_size_], 0,
+           (size - window_size_) * sizeof(Fft::Complex));
+    fft_.Forward(spectrum_.data());
+    for (int k = 0; k < size; ++k) {
+      spectrum_[k] = std::norm(spectrum_[k]);
+    }
+    fft_.Inverse(spectrum_.data());
+
+    nsdf_[0] = 1.0;
+    for (int lag = 1; lag <= max_lag_; ++lag) {
+      // The samples that no longer overlap.
+      m -= (double) samples[lag - 1] * samples[lag - 1]
+        + (double) samples[window_size_ - lag] * samples[window_size_ - lag];
+      nsdf_[lag] = m > 0 ? 2 * spectrum_[lag].real() / size / m : 0.0;
+    }
+
+    // The highest value between each positive and negative going zero
+    // crossing, after the one of lag 0.
+    peaks_.clear();
+    double highest = 0;
+    int lag = 1;
+    while (lag < max_lag_ && nsdf_[lag] > 0) ++lag;
+    while (lag < max_lag_) {
+      while (lag < max_lag_ && nsdf_[lag] <= 0) ++lag;
+      int peak = lag;
+      while (lag < max_lag_ && nsdf_[lag] > 0) {
+        if (nsdf_[lag] > nsdf_[peak]) peak = lag;
+        ++lag;
+      }
+      // The last one may be cut off by the end of the lags.
+      if (peak >= min_lag_ && peak < max_lag_ - 1) {
+        peaks_.push_back(peak);
+        if (nsdf_[peak] > highest) highest = nsdf_[peak];
+      }
+    }
+    if (highest < kMpmMinClarity)
+      return 0.0;
+    for (int peak : peaks_) {
+      if (nsdf_[peak] < kMpmCutoff * highest)
+        continue;
+      const double offset = ParabolaVertex(nsdf_[peak - 1], nsdf_[peak],
+                                           nsdf_[peak + 1]);
+      return sample_rate_ / (peak + offset);
+    }
+    return 0.0;
+  }
+
+private:
+  std::vector<double> nsdf_;   // Per lag.
+  std::vector<int> peaks_;     // Lags of the key maxima.
+};
+}  // namespace
+
+PitchDetector *PitchDetector::Create(const char *engine, int window_size,
+                                     int sample_rate) {
+  if (strcmp(engine, "wavelet") == 0)
+    return new WaveletDetector(window_size, sample_rate);
+  if (strcmp(engine, "yin") == 0)
+    return new YinDetector(window_size, sample_rate);
+  if (strcmp(engine, "mpm") == 0)
+    return new MpmDetector(window_size, sample_rate);
+  return NULL;
+}
@@ -0,0 +1,45 @@
+#ifndef PITCH_HERO_PITCH_DETECTOR_H
+#define PITCH_HERO_PITCH_DETECTOR_H
+
+#include "dywapitchtrack.h"
+
+// Finds the raw pitch of a window of samples. There is no tracking from
+// window to window in here; the dynamic tracking that corrects octave
+// errors runs on top of whichever detector is used.
+//
+// The engines trade speed for accuracy differently:
+//   wavelet: the dywapitch wavelet algorithm; fast, and cheaper still if
+//            the window slides by a small part of it.
+//   yin    : YIN, the cumulative mean normalized difference function.
+//   mpm    : The McLeod pitch method, picking peaks of the normalized
+//            square difference function.
+// YIN and MPM work on the autocorrelation of the window, computed with
+// the FFT in O(n log n).
+class PitchDetector {
+public:
+  // Names of the engines; the first is the default.
+  static const int kEngineCount = 3;
+  static const char *const kEngines[kEngineCount];
+
+  // Detector "engine" for windows of "window_size" samples at
+  // "sample_rate". NULL if there is no such engine.
+  static PitchDetector *Create(const char *engine, int window_size,
+                               int sample_rate);
+  virtual ~PitchDetector() {}
+
+  virtual const char *name() const = 0;
+
+  // Precision of the computation, for detectors that have a choice.
+  virtual void set_precision(dywapitch_precision) {}
+
+  // Pitch of the window of "samples" in Hz; 0.0 if none found. "advanced"
+  // is how far the window moved since the previous call, 0 if unrelated;
+  // a detector may reuse the work on the part it has seen already.
+  virtual double ComputePitch(const short *samples, int advanced) = 0;
+
+  // Wavelet levels the last ComputePitch() went through; -1 if the
+  // detector has no levels.
+  virtual int levels_used() const { return -1; }
+};
+
+#endif  // PITCH_HERO_PITCH_DETECTOR_H
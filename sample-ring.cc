@@ -0,0 +1,47 @@
+#include "sample-ring.h"
+
+#include <stdio.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+size_t RoundUpToPageSize(size_t bytes) {
+  const size_t page_size = sysconf(_SC_PAGESIZE);
+  return (bytes + page_size - 1) / page_size * page_size;
+}
+
+void *MapMirroredMemory(size_t bytes) {
+  const int fd = memfd_create("pitch-hero-ring", MFD_CLOEXEC);
+  if (fd < 0) {
+    perror("memfd_create()");
+    return NULL;
+  }
+  if (ftruncate(fd, bytes) < 0) {
+    perror("ftruncate()");
+    close(fd);
+    return NULL;
+  }
+  // First reserve address space for both copies, then map the same file
+  // into both halves.
+  char *base = (char*) mmap(NULL, 2 * bytes, PROT_NONE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) {
+    perror("mmap(reserve)");
+    close(fd);
+    return NULL;
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (mmap(base + i * bytes, bytes, PROT_READ | PROT_WRITE,
+             MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED) {
+      perror("mmap(mirror)");
+      munmap(base, 2 * bytes);
+      close(fd);
+      return NULL;
+    }
+  }
+  close(fd);  // The mappings keep the memory alive.
+  return base;
+}
+
+void UnmapMirroredMemory(void *mem, size_t bytes) {
+  munmap(mem, 2 * bytes);
+}
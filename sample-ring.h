@@ -0,0 +1,84 @@
+#ifndef PITCH_HERO_SAMPLE_RING_H
+#define PITCH_HERO_SAMPLE_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+
+size_t RoundUpToPageSize(size_t bytes);
+
+// Map "bytes" (a multiple of the page size) of memory twice, back to back.
+// Returns NULL on failure.
+void *MapMirroredMemory(size_t bytes);
+void UnmapMirroredMemory(void *mem, size_t bytes);
+
+// Lock-free single producer, single consumer ring buffer of samples.
+//
+// The underlying memory is mapped twice in a row in virtual memory, so
+// any range of up to capacity() samples starting at the read or write
+// position is contiguous. Consumers can thus look at a whole analysis
+// window without copying, and sliding the window is just moving the read
+// position.
+template <typename T> class SampleRing {
+public:
+  // Create a ring holding at least "min_capacity" samples. The capacity
+  // is rounded up to fill whole pages. Returns NULL on failure.
+  static SampleRing *Create(int min_capacity);
+  ~SampleRing() { UnmapMirroredMemory(buffer_, capacity_ * sizeof(T)); }
+
+  int capacity() const { return capacity_; }
+
+  // -- Producer side.
+  // Number of samples that can be written without overwriting unread ones.
+  int WriteSpace() const {
+    return capacity_ - (write_pos_.load(std::memory_order_relaxed)
+                        - read_pos_.load(std::memory_order_acquire));
+  }
+  // Contiguous space for up to WriteSpace() samples.
+  T *WritePointer() {
+    return buffer_ + write_pos_.load(std::memory_order_relaxed) % capacity_;
+  }
+  // Publish "count" samples written to WritePointer().
+  void CommitWrite(int count) {
+    write_pos_.fetch_add(count, std::memory_order_release);
+  }
+
+  // -- Consumer side.
+  // Number of samples available to read.
+  int ReadAvailable() const {
+    return write_pos_.load(std::memory_order_acquire)
+      - read_pos_.load(std::memory_order_relaxed);
+  }
+  // Contiguous view of the ReadAvailable() samples.
+  const T *ReadPointer() const {
+    return buffer_ + read_pos_.load(std::memory_order_relaxed) % capacity_;
+  }
+  // Release "count" samples to the producer.
+  void CommitRead(int count) {
+    read_pos_.fetch_add(count, std::memory_order_release);
+  }
+
+private:
+  SampleRing(T *buffer, int capacity)
+    : buffer_(buffer), capacity_(capacity), write_pos_(0), read_pos_(0) {}
+
+  T *const buffer_;
+  const int capacity_;
+  // Separate cache lines, as they are written by different threads.
+  alignas(64) std::atomic<uint64_t> write_pos_;
+  alignas(64) std::atomic<uint64_t> read_pos_;
+};
+
+template <typename T>
+SampleRing<T> *SampleRing<T>::Create(int min_capacity) {
+  // Element size needs to divide the page size, so that the mirror
+  // boundary never falls in the middle of a sample.
+  static_assert((4096 % sizeof(T)) == 0, "Odd sample size");
+  const size_t bytes = RoundUpToPageSize(min_capacity * sizeof(T));
+  T *buffer = (T*) MapMirroredMemory(bytes);
+  if (buffer == NULL) return NULL;
+  return new SampleRing(buffer, bytes / sizeof(T));
+}
+
+#endif  // PITCH_HERO_SAMPLE_RING_H
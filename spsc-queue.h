@@ -0,0 +1,39 @@
+#ifndef PITCH_HERO_SPSC_QUEUE_H
+#define PITCH_HERO_SPSC_QUEUE_H
+
+#include <atomic>
+
+// Bounded lock-free queue for exactly one producer and one consumer
+// thread. Never blocks: Push() fails if the queue is full, Pop() if it is
+// empty. "N" needs to be a power of two.
+template <typename T, unsigned int N> class SPSCQueue {
+public:
+  SPSCQueue() : head_(0), tail_(0) {
+    static_assert((N & (N - 1)) == 0, "Queue size must be a power of two");
+  }
+
+  bool Push(const T &value) {
+    const unsigned int tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == N)
+      return false;
+    items_[tail % N] = value;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(T *value) {
+    const unsigned int head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    *value = items_[head % N];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T items_[N];
+  alignas(64) std::atomic<unsigned int> head_;   // Written by consumer.
+  alignas(64) std::atomic<unsigned int> tail_;   // Written by producer.
+};
+
+#endif  // PITCH_HERO_SPSC_QUEUE_H
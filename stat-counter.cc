@@ -0,0 +1,66 @@
+#include "stat-counter.h"
+
+#include <math.h>
+
+RecentStatCounter::RecentStatCounter(int max_note, double seconds)
+  : note_count_(max_note), slice_seconds_(seconds / kSlices),
+    totals_(new int [max_note * StatCounter::kBuckets]),
+    stats_(max_note), stats_valid_(false),
+    slices_(new int [kSlices * max_note * StatCounter::kBuckets]),
+    current_(0) {
+  Reset();
+}
+
+RecentStatCounter::~RecentStatCounter() {
+  delete [] slices_;
+  delete [] totals_;
+}
+
+void RecentStatCounter::Reset() {
+  memset(totals_, 0, note_count_ * StatCounter::kBuckets * sizeof(int));
+  stats_valid_ = false;
+  memset(slices_, 0, kSlices * note_count_ * StatCounter::kBuckets
+         * sizeof(int));
+  memset(slice_counts_, 0, sizeof(slice_counts_));
+}
+
+void RecentStatCounter::Count(int note, double cent, double now) {
+  if (note < 0 || note >= note_count_) return;
+  Expire(now);
+  const int index = note * StatCounter::kBuckets + StatCounter::Bucket(cent);
+  ++slice(current_)[index];
+  ++slice_counts_[current_ % kSlices];
+  ++totals_[index];
+  stats_valid_ = false;
+}
+
+void RecentStatCounter::Expire(double now) {
+  const long number = (long) floor(now / slice_seconds_);
+  if (number - current_ >= kSlices) {
+    Reset();   // All of it is too old.
+    current_ = number;
+    return;
+  }
+  while (current_ < number) {
+    ++current_;
+    // The slice to count into next is the oldest one.
+    int *const old = slice(current_);
+    if (slice_counts_[current_ % kSlices] == 0)
+      continue;
+    for (int i = 0; i < note_count_ * StatCounter::kBuckets; ++i)
+      totals_[i] -= old[i];
+    stats_valid_ = false;
+    memset(old, 0, note_count_ * StatCounter::kBuckets * sizeof(int));
+    slice_counts_[current_ % kSlices] = 0;
+  }
+}
+
+const StatCounter &RecentStatCounter::stats() {
+  if (!stats_valid_) {
+    stats_.Reset();
+    for (int note = 0; note < note_count_; ++note)
+      stats_.Add(note, totals_ + note * StatCounter::kBuckets);
+    stats_valid_ = true;
+  }
+  return stats_;
+}
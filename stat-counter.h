@@ -0,0 +1,145 @@
+#ifndef PITCH_HERO_STAT_COUNTER_H
+#define PITCH_HERO_STAT_COUNTER_H
+
+#include <string.h>
+
+// How often each note was played how much out of tune: a histogram of the
+// cent deviation per note.
+//
+// The histograms are kept as prefix sums, note after note in one array:
+// counting costs a few more additions, but how many counts are flat, in
+// tune or sharp for any threshold is just three lookups, which keeps the
+// statistics screen quick with fine buckets.
+class StatCounter {
+public:
+  // Buckets of the histogram per note, one cent wide: -50 to +49 cent.
+  static const int kBuckets = 100;
+
+  struct Counter {
+    Counter() : flat(0), ok(0), sharp(0) {}
+    int flat;
+    int ok;
+    int sharp;
+  };
+  StatCounter(int max_note) : note_count_(max_note),
+                              below_(new int [max_note * kStride]) {
+    Reset();
+  }
+  ~StatCounter() { delete [] below_; }
+
+  void Reset() {
+    memset(below_, 0, note_count_ * kStride * sizeof(int));
+  }
+  // The bucket "cent" is counted in. Like the 5 cent buckets before, the
+  // cents are rounded toward zero: -5.5 is within a threshold of 5.
+  static int Bucket(double cent) {
+    const int index = (int) cent + 50;
+    if (index < 0) return 0;
+    if (index > kBuckets - 1) return kBuckets - 1;
+    return index;
+  }
+
+  void Count(int note, double cent) {
+    if (note < 0 || note >= note_count_) return;
+    int *below = below_ + note * kStride;
+    for (int i = Bucket(cent) + 1; i <= kBuckets; ++i) {
+      ++below[i];
+    }
+  }
+
+  // Raw access to the histogram, e.g. to store it.
+  int count(int note, int bucket) const {
+    const int *below = below_ + note * kStride;
+    return below[bucket + 1] - below[bucket];
+  }
+  // Add the kBuckets "counts" of a histogram of "note".
+  void Add(int note, const int *counts) {
+    int *below = below_ + note * kStride;
+    int sum = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+      sum += counts[i];
+      below[i + 1] += sum;
+    }
+  }
+
+  int size() const { return note_count_; }
+
+  // Counts more than "threshold" cent flat, within, and at least that much
+  // sharp.
+  Counter get_stat_for(int note, int threshold) const {
+    Counter result;
+    if (note < 0 || note >= note_count_) return result;
+    if (threshold > kBuckets / 2) threshold = kBuckets / 2;
+    const int *below = below_ + note * kStride;
+    const int low = below[kBuckets / 2 - threshold];
+    const int high = below[kBuckets / 2 + threshold];
+    result.flat = low;
+    result.ok = high - low;
+    result.sharp = below[kBuckets] - high;
+    return result;
+  }
+
+  // Sum over all notes.
+  Counter get_total_for(int threshold) const {
+    Counter result;
+    for (int note = 0; note < note_count_; ++note) {
+      const Counter c = get_stat_for(note, threshold);
+      result.flat += c.flat;
+      result.ok += c.ok;
+      result.sharp += c.sharp;
+    }
+    return result;
+  }
+
+private:
+  // Per note, below[i] is the number of counts in buckets before i.
+  static const int kStride = kBuckets + 1;
+
+  const int note_count_;
+  int *const below_;
+};
+
+// Statistics of only the most recent playing, e.g. the last five minutes.
+//
+// Counts go into slices of time as well as into a raw histogram of the
+// total, one increment each; when the oldest slice falls out of the
+// window, it is subtracted from the total again, every window / kSlices
+// seconds. The prefix sums of a StatCounter are only built from the total
+// when the statistics are asked for. The window covers between
+// kSlices - 1 and kSlices slices.
+class RecentStatCounter {
+public:
+  RecentStatCounter(int max_note, double seconds);
+  ~RecentStatCounter();
+
+  double seconds() const { return slice_seconds_ * kSlices; }
+
+  void Reset();
+
+  // Count at "now" seconds; time never goes back.
+  void Count(int note, double cent, double now);
+
+  // Take out what is older than the window at "now".
+  void Expire(double now);
+
+  // The counts in the window, as of the last Count() or Expire().
+  const StatCounter &stats();
+
+private:
+  static const int kSlices = 60;
+
+  int *slice(long number) {
+    return slices_ + (number % kSlices) * note_count_ * StatCounter::kBuckets;
+  }
+
+  const int note_count_;
+  const double slice_seconds_;
+  int *const totals_;          // Raw histogram of the window.
+  StatCounter stats_;          // Built from totals_ if stats_valid_ is false.
+  bool stats_valid_;
+  int *const slices_;          // Raw histograms of kSlices, note after note.
+  int slice_counts_[kSlices];  // Number of counts in each.
+  long current_;               // Number of the slice counted into.
+};
+
+#endif  // PITCH_HERO_STAT_COUNTER_H
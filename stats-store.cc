@@ -0,0 +1,247 @@
+#include "stats-store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "stat-counter.h"
+
+// All numbers are in native byte order.
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t notes;
+  uint32_t buckets;
+  uint32_t record_size;
+  uint32_t crc;          // Of the fields above.
+  uint32_t reserved;
+};
+
+// Followed by notes * buckets counts, summed over all sessions of the
+// player so far, note by note; then padding to a multiple of 8 bytes.
+struct StatsStore::Record {
+  uint32_t magic;
+  int32_t player;
+  int32_t previous;      // Index of the previous session of the player.
+  uint32_t crc;          // Of the whole record, this field left out.
+  int64_t start_time;    // Seconds since the epoch.
+  int64_t end_time;
+};
+
+static const char kFileMagic[8] = { 'P', 'H', 'S', 'T', 'A', 'T', 'S', '\0' };
+static const uint32_t kFileVersion = 1;
+static const uint32_t kRecordMagic = 0x53455353;  // "SESS"
+
+static uint32_t Crc32(uint32_t crc, const void *data, size_t len) {
+  static uint32_t table[256];
+  if (table[1] == 0) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      uint32_t c = i;
+      for (int bit = 0; bit < 8; ++bit)
+        c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+      table[i] = c;
+    }
+  }
+  const uint8_t *bytes = (const uint8_t*) data;
+  crc = ~crc;
+  for (size_t i = 0; i < len; ++i)
+    crc = table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+  return ~crc;
+}
+
+uint32_t StatsStore::RecordCrc(const Record *r, size_t size) {
+  const size_t crc_pos = offsetof(Record, crc);
+  const char *bytes = (const char*) r;
+  const uint32_t crc = Crc32(0, bytes, crc_pos);
+  return Crc32(crc, bytes + crc_pos + sizeof(uint32_t),
+               size - crc_pos - sizeof(uint32_t));
+}
+
+StatsStore *StatsStore::Open(const char *filename, int notes, int buckets) {
+  const int fd = open(filename, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "Can't open %s: %s\n", filename, strerror(errno));
+    return NULL;
+  }
+  StatsStore *store = new StatsStore(filename, fd, notes, buckets);
+  // Two instances appending at once would write their records over each
+  // other.
+  if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+    if (errno == EWOULDBLOCK)
+      fprintf(stderr, "%s is in use by another pitch-hero.\n", filename);
+    else
+      fprintf(stderr, "Can't lock %s: %s\n", filename, strerror(errno));
+    delete store;
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    fprintf(stderr, "%s: %s\n", filename, strerror(errno));
+    delete store;
+    return NULL;
+  }
+
+  FileHeader header;
+  memset(&header, 0, sizeof(header));
+  if (st.st_size == 0) {
+    memcpy(header.magic, kFileMagic, sizeof(header.magic));
+    header.version = kFileVersion;
+    header.notes = notes;
+    header.buckets = buckets;
+    header.record_size = store->record_size_;
+    header.crc = Crc32(0, &header, offsetof(FileHeader, crc));
+    if (pwrite(fd, &header, sizeof(header), 0) != sizeof(header)
+        || fsync(fd) < 0) {
+      fprintf(stderr, "Can't write %s: %s\n", filename, strerror(errno));
+      delete store;
+      return NULL;
+    }
+    st.st_size = sizeof(header);
+  } else if (pread(fd, &header, sizeof(header), 0) != sizeof(header)
+             || memcmp(header.magic, kFileMagic, sizeof(header.magic)) != 0
+             || header.crc != Crc32(0, &header, offsetof(FileHeader, crc))) {
+    fprintf(stderr, "%s is not a pitch-hero statistics file.\n", filename);
+    delete store;
+    return NULL;
+  } else if (header.version != kFileVersion) {
+    fprintf(stderr, "%s has version %u; can only read version %u.\n",
+            filename, header.version, kFileVersion);
+    delete store;
+    return NULL;
+  } else if ((int) header.notes != notes || (int) header.buckets != buckets
+             || header.record_size != store->record_size_) {
+    fprintf(stderr, "%s has statistics of %u notes with %u buckets each; "
+            "expected %d with %d.\n", filename, header.notes, header.buckets,
+            notes, buckets);
+    delete store;
+    return NULL;
+  }
+
+  // A crash while appending leaves a torn record at the end; only the
+  // last one can be affected.
+  const size_t data_size = st.st_size - sizeof(FileHeader);
+  store->sessions_ = data_size / store->record_size_;
+  if (!store->Map()) {
+    delete store;
+    return NULL;
+  }
+  if (store->sessions_ > 0 && !store->valid(store->sessions_ - 1))
+    store->sessions_--;
+  if (store->sessions_ * store->record_size_ != data_size) {
+    fprintf(stderr, "%s: dropping incomplete session at the end.\n",
+            filename);
+    const off_t size = sizeof(FileHeader)
+      + store->sessions_ * store->record_size_;
+    if (ftruncate(fd, size) < 0 || !store->Map()) {
+      fprintf(stderr, "Can't truncate %s: %s\n", filename, strerror(errno));
+      delete store;
+      return NULL;
+    }
+  }
+  return store;
+}
+
+StatsStore::StatsStore(const char *filename, int fd, int notes, int buckets)
+  : filename_(filename), fd_(fd), notes_(notes), buckets_(buckets),
+    record_size_((sizeof(Record) + notes * buckets * sizeof(uint32_t) + 7)
+                 / 8 * 8),
+    sessions_(0), map_(NULL), map_size_(0) {
+}
+
+StatsStore::~StatsStore() {
+  if (map_) munmap(map_, map_size_);
+  close(fd_);
+}
+
+bool StatsStore::Map() {
+  if (map_) munmap(map_, map_size_);
+  map_size_ = sizeof(FileHeader) + sessions_ * record_size_;
+  map_ = mmap(NULL, map_size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (map_ == MAP_FAILED) {
+    fprintf(stderr, "Can't map %s: %s\n", filename_.c_str(), strerror(errno));
+    map_ = NULL;
+    return false;
+  }
+  return true;
+}
+
+const StatsStore::Record *StatsStore::record(int i) const {
+  return (const Record*) ((const char*) map_ + sizeof(FileHeader)
+                          + i * record_size_);
+}
+
+const uint32_t *StatsStore::totals(int i) const {
+  return (const uint32_t*) (record(i) + 1);
+}
+
+bool StatsStore::valid(int i) const {
+  const Record *r = record(i);
+  return r->magic == kRecordMagic && r->crc == RecordCrc(r, record_size_);
+}
+
+int StatsStore::player(int i) const { return record(i)->player; }
+time_t StatsStore::start_time(int i) const { return record(i)->start_time; }
+time_t StatsStore::end_time(int i) const { return record(i)->end_time; }
+int StatsStore::previous(int i) const { return record(i)->previous; }
+
+void StatsStore::AddTotals(int since, int i, StatCounter *stats) const {
+  const uint32_t *after = totals(i);
+  const uint32_t *before = since >= 0 ? totals(since) : NULL;
+  std::vector<int> counts(buckets_);
+  for (int note = 0; note < notes_; ++note) {
+    for (int b = 0; b < buckets_; ++b) {
+      const int pos = note * buckets_ + b;
+      counts[b] = after[pos] - (before ? before[pos] : 0);
+    }
+    stats->Add(note, counts.data());
+  }
+}
+
+int StatsStore::LastSession(int player) const {
+  for (int i = sessions_ - 1; i >= 0; --i) {
+    if (record(i)->player == player && valid(i))
+      return i;
+  }
+  return -1;
+}
+
+bool StatsStore::Append(int player, time_t start, time_t end,
+                        const StatCounter &stats) {
+  std::vector<char> buffer(record_size_, 0);
+  Record *r = (Record*) buffer.data();
+  r->magic = kRecordMagic;
+  r->player = player;
+  r->previous = LastSession(player);
+  r->start_time = start;
+  r->end_time = end;
+  uint32_t *after = (uint32_t*) (r + 1);
+  const uint32_t *before = r->previous >= 0 ? totals(r->previous) : NULL;
+  for (int note = 0; note < notes_; ++note) {
+    for (int b = 0; b < buckets_; ++b) {
+      const int pos = note * buckets_ + b;
+      after[pos] = (before ? before[pos] : 0) + stats.count(note, b);
+    }
+  }
+  r->crc = RecordCrc(r, record_size_);
+
+  const off_t offset = sizeof(FileHeader) + sessions_ * record_size_;
+  if (pwrite(fd_, buffer.data(), record_size_, offset)
+      != (ssize_t) record_size_ || fdatasync(fd_) < 0) {
+    fprintf(stderr, "Can't write session to %s: %s\n", filename_.c_str(),
+            strerror(errno));
+    if (ftruncate(fd_, offset) < 0) {
+      fprintf(stderr, "Can't truncate %s: %s; the torn session is dropped "
+              "when opening it next.\n", filename_.c_str(), strerror(errno));
+    }
+    return false;
+  }
+  ++sessions_;
+  return Map();
+}
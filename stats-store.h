@@ -0,0 +1,75 @@
+#ifndef PITCH_HERO_STATS_STORE_H
+#define PITCH_HERO_STATS_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+
+class StatCounter;
+
+// Statistics of past practice sessions in a file, to compare them later.
+//
+// The file is a header followed by fixed size session records; it is only
+// ever appended to. Each record holds the histograms of a player summed
+// over all of their sessions up to and including that one, so the
+// statistics of any range of sessions (a week, say) are the difference of
+// two records. Records carry a checksum and are synced to disk once
+// written; a record torn by a crash is dropped when opening the file.
+//
+// The file is memory mapped, so opening it costs the same no matter how
+// many sessions it holds.
+class StatsStore {
+public:
+  // Open or create "filename" for histograms of "notes" notes with
+  // "buckets" buckets each. Returns NULL and prints a message on failure,
+  // e.g. if the file holds histograms of a different shape, or another
+  // instance has it open: the file stays locked until the store is deleted.
+  static StatsStore *Open(const char *filename, int notes, int buckets);
+  ~StatsStore();
+
+  int sessions() const { return sessions_; }
+
+  // -- Session "i", 0 is the oldest.
+  // Whether the checksum of the record matches; the accessors below
+  // return garbage otherwise.
+  bool valid(int i) const;
+  int player(int i) const;
+  time_t start_time(int i) const;
+  time_t end_time(int i) const;
+  // Previous session of the same player, -1 if none.
+  int previous(int i) const;
+
+  // Add the histograms of the player's sessions after "since" (-1: from
+  // the beginning) up to and including "i" to "stats".
+  void AddTotals(int since, int i, StatCounter *stats) const;
+
+  // Newest session of "player", -1 if none.
+  int LastSession(int player) const;
+
+  // Append a session of "player" with the histograms in "stats" and make
+  // sure it is on disk. Returns false and prints a message on failure.
+  bool Append(int player, time_t start, time_t end, const StatCounter &stats);
+
+private:
+  struct Record;
+
+  StatsStore(const char *filename, int fd, int notes, int buckets);
+  static uint32_t RecordCrc(const Record *r, size_t size);
+
+  bool Map();
+  const Record *record(int i) const;
+  const uint32_t *totals(int i) const;
+
+  const std::string filename_;
+  const int fd_;
+  const int notes_;
+  const int buckets_;
+  const size_t record_size_;
+  int sessions_;
+  void *map_;
+  size_t map_size_;
+};
+
+#endif  // PITCH_HERO_STATS_STORE_H
@@ -0,0 +1,153 @@
+#include "synth-signal.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "audio-file.h"
+
+namespace {
+// Small, fast and the same everywhere, unlike rand().
+class Random {
+public:
+  explicit Random(uint32_t seed) : state_(seed) {}
+  // Uniform in [-1, 1).
+  double Next() {
+    state_ ^= state_ << 13;
+    state_ ^= state_ >> 17;
+    state_ ^= state_ << 5;
+    return state_ / 2147483648.0 - 1.0;
+  }
+
+private:
+  uint32_t state_;
+};
+
+struct Voice {
+  const double *notes;       // Played in a loop.
+  int note_count;
+  double note_seconds;
+  int harmonics;
+  double vibrato_cents;
+  double noise;              // Relative to full scale.
+};
+}  // namespace
+
+static SynthSignal Synthesize(const char *name, const Voice &v,
+                              int sample_rate, double seconds, uint32_t seed) {
+  static const double kAmplitude = 0.5;     // Of full scale, for the sum.
+  static const double kVibratoHz = 5.5;
+  static const double kAttackSeconds = 0.01;
+  SynthSignal s;
+  s.name = name;
+  const int count = seconds * sample_rate;
+  s.samples.resize(count);
+  s.freq.resize(count);
+  Random random(seed);
+  // Normalize the 1/k overtone series to kAmplitude.
+  double norm = 0;
+  for (int k = 1; k <= v.harmonics; ++k) norm += 1.0 / k;
+  const int note_samples = v.note_seconds * sample_rate;
+  double phase = 0;
+  for (int i = 0; i < count; ++i) {
+    const int note_start = i - i % note_samples;
+    double f = 0;
+    double value = 0;
+    if (v.note_count > 0) {
+      const double t = (double) i / sample_rate;
+      f = v.notes[(i / note_samples) % v.note_count];
+      f *= pow(2, v.vibrato_cents / 1200 * sin(2 * M_PI * kVibratoHz * t));
+      phase += 2 * M_PI * f / sample_rate;
+      if (phase > 2 * M_PI) phase -= 2 * M_PI;
+      for (int k = 1; k <= v.harmonics; ++k) {
+        value += sin(k * phase) / k;
+      }
+      const double attack = (i - note_start) / (kAttackSeconds * sample_rate);
+      value *= kAmplitude / norm * (attack < 1 ? attack : 1);
+    }
+    value += v.noise * random.Next();
+    s.samples[i] = lrint(32767 * (value > 1 ? 1 : (value < -1 ? -1 : value)));
+    s.freq[i] = f;
+  }
+  return s;
+}
+
+std::vector<SynthSignal> MakeSynthSignals(int sample_rate, double seconds) {
+  // C major from the cello C string up two and a half octaves.
+  static const double kScale[] = {
+    65.41, 73.42, 82.41, 87.31, 98.00, 110.00, 123.47,
+    130.81, 146.83, 164.81, 174.61, 196.00, 220.00, 246.94,
+    261.63, 293.66, 329.63, 349.23, 392.00, 440.00,
+  };
+  static const double kOctaves[] = { 110.0, 220.0, 440.0, 220.0, 110.0, 440.0 };
+  static const int kScaleCount = sizeof(kScale) / sizeof(kScale[0]);
+  static const int kOctaveCount = sizeof(kOctaves) / sizeof(kOctaves[0]);
+
+  const Voice harmonics = { kScale, kScaleCount, 0.5, 8, 0, 0 };
+  const Voice vibrato = { kScale, kScaleCount, 0.5, 8, 30, 0 };
+  const Voice noise = { kScale, kScaleCount, 0.5, 8, 0, 0.07 };
+  const Voice silence = { NULL, 0, 0.5, 0, 0, 0.0003 };
+  const Voice octaves = { kOctaves, kOctaveCount, 0.25, 8, 0, 0 };
+
+  std::vector<SynthSignal> result;
+  result.push_back(Synthesize("harmonics", harmonics, sample_rate, seconds, 1));
+  result.push_back(Synthesize("vibrato", vibrato, sample_rate, seconds, 2));
+  result.push_back(Synthesize("noise", noise, sample_rate, seconds, 3));
+  result.push_back(Synthesize("silence", silence, sample_rate, seconds, 4));
+  result.push_back(Synthesize("octaves", octaves, sample_rate, seconds, 5));
+  return result;
+}
+
+bool ReadLabeledRecording(const char *audio_file, const char *label_file,
+                          int sample_rate, SynthSignal *out) {
+  AudioFile *in = AudioFile::Open(audio_file, sample_rate, 1);
+  if (in == NULL)
+    return false;
+  if ((int) in->sample_rate() != sample_rate) {
+    fprintf(stderr, "%s: %u Hz instead of %d Hz.\n", audio_file,
+            in->sample_rate(), sample_rate);
+    delete in;
+    return false;
+  }
+  out->name = audio_file;
+  out->samples.clear();
+  std::vector<short> frames(4096 * in->channels());
+  int count;
+  while ((count = in->Read(frames.data(), 4096)) > 0) {
+    for (int i = 0; i < count; ++i)
+      out->samples.push_back(frames[i * in->channels()]);
+  }
+  delete in;
+
+  FILE *labels = fopen(label_file, "r");
+  if (labels == NULL) {
+    perror(label_file);
+    return false;
+  }
+  out->freq.assign(out->samples.size(), 0.0f);
+  size_t pos = 0;    // freq[] is filled up to here.
+  float current = 0;
+  char line[1024];
+  int line_no = 0;
+  while (fgets(line, sizeof(line), labels) != NULL) {
+    ++line_no;
+    double time, freq;
+    if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+      continue;
+    if (sscanf(line, "%lf %lf", &time, &freq) != 2 || time < 0 || freq < 0) {
+      fprintf(stderr, "%s:%d: expected time and frequency.\n",
+              label_file, line_no);
+      fclose(labels);
+      return false;
+    }
+    const size_t start = time * sample_rate;
+    for (; pos < start && pos < out->freq.size(); ++pos)
+      out->freq[pos] = current;
+    current = freq;
+  }
+  for (; pos < out->freq.size(); ++pos)
+    out->freq[pos] = current;
+  fclose(labels);
+  return true;
+}
@@ -0,0 +1,31 @@
+#ifndef PITCH_HERO_SYNTH_SIGNAL_H
+#define PITCH_HERO_SYNTH_SIGNAL_H
+
+#include <string>
+#include <vector>
+
+// A test signal together with its true fundamental frequency.
+struct SynthSignal {
+  std::string name;
+  std::vector<short> samples;
+  std::vector<float> freq;   // Per sample, in Hz; 0.0 where there is none.
+};
+
+// The signals the pitch tracker is measured on, each "seconds" long:
+//   harmonics : a scale over the cello range, bowed-string-like overtones.
+//   vibrato   : the same with a 5.5 Hz, +/-30 cent vibrato.
+//   noise     : the scale with white noise about 12 dB below it.
+//   silence   : faint noise, nothing to be found.
+//   octaves   : jumps between octaves of A, the classic trap for trackers.
+// They only depend on the arguments, so runs can be compared over time.
+std::vector<SynthSignal> MakeSynthSignals(int sample_rate, double seconds);
+
+// Read a recording (first channel) with hand checked pitch labels. The
+// label file has a line "<time_s> <freq_hz>" wherever the pitch changes,
+// 0 where there is none; '#' starts a comment. The output of
+// 'pitch-hero -f' is in this format. The recording needs to have
+// "sample_rate". Returns false and prints a message on failure.
+bool ReadLabeledRecording(const char *audio_file, const char *label_file,
+                          int sample_rate, SynthSignal *out);
+
+#endif  // PITCH_HERO_SYNTH_SIGNAL_H